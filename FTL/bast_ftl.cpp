@@ -28,7 +28,12 @@
  * every time a page read is out a cache log page. A cache log page usually hold approx.
  * 1000 mappings.
  *
- * Second notice. Victim mappings still need to be implemented.
+ * When all BAST_LOG_BLOCK_LIMIT log blocks are taken, the log block merged
+ * to make room is chosen by BAST_VICTIM_POLICY.  Log blocks are kept in
+ * write order (an intrusive list through prev/next) and in an array of
+ * slots for random picks, and, for the policies needing them, in a set
+ * ordered by valid pages and a queue of full blocks that can be switched.
+ * Disposed log blocks are pooled and reused.
  */
 
 #include <new>
@@ -37,6 +42,7 @@
 #include <math.h>
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include "ssd.h"
 
 using namespace ssd;
@@ -46,15 +52,21 @@ LogPageBlock::LogPageBlock()
 	pages = new int[BLOCK_SIZE];
 	aPages = new long[BLOCK_SIZE];
 
-	for (uint i=0;i<BLOCK_SIZE;i++)
-	{
-		pages[i] = -1;
-		aPages[i] = -1;
-	}
+	reset();
+}
+
+void LogPageBlock::reset()
+{
+	std::fill_n(pages, BLOCK_SIZE, -1);
+	std::fill_n(aPages, BLOCK_SIZE, -1);
 
 	numPages = 0;
 
 	next = NULL;
+	prev = NULL;
+	lba = -1;
+	slot = 0;
+	switchQueued = false;
 }
 
 
@@ -71,7 +83,9 @@ bool LogPageBlock::operator() (const LogPageBlock& lhs, const LogPageBlock& rhs)
 }
 
 FtlImpl_Bast::FtlImpl_Bast(Controller &controller):
-	FtlParent(controller)
+	FtlParent(controller),
+	lru_head(NULL),
+	lru_tail(NULL)
 {
 
 	// Detect required number of bits for logical address size
@@ -94,6 +108,11 @@ FtlImpl_Bast::FtlImpl_Bast(Controller &controller):
 FtlImpl_Bast::~FtlImpl_Bast(void)
 {
 	delete data_list;
+
+	for (uint i=0;i<log_slots.size();i++)
+		delete log_slots[i];
+	for (uint i=0;i<log_pool.size();i++)
+		delete log_pool[i];
 }
 
 enum status FtlImpl_Bast::read(Event &event)
@@ -155,21 +174,34 @@ enum status FtlImpl_Bast::write(Event &event)
 			Address replace_address = Address(logBlock->address.get_linear_address()+logBlock->pages[eventAddress.page], PAGE);
 			event.set_replace_address(replace_address);
 		}
+		else
+			set_log_pages(logBlock, logBlock->numPages + 1);
 
 		logBlock->pages[eventAddress.page] = numValid;
+		log_touch(logBlock);
+
+		// Filled in order, the block can be switched when chosen as victim
+		if (BAST_VICTIM_POLICY == BAST_VICTIM_SWITCH_FIRST && numValid + 1 == BLOCK_SIZE && is_switchable(logBlock))
+		{
+			switch_candidates.push_back(lba);
+			logBlock->switchQueued = true;
+		}
 
 		Address logBlockAddress = logBlock->address;
 
 		controller.get_free_page(logBlockAddress);
 		event.set_address(logBlockAddress);
 	} else {
+		controller.stats.latency_begin(LATENCY_MERGE, event);
 		if (!is_sequential(logBlock, lba, event))
 			random_merge(logBlock, lba, event);
+		controller.stats.latency_end(event);
 
 		allocate_new_logblock(logBlock, lba, event);
 		logBlock = log_map[lba];
 		// Write the current io to a new block.
 		logBlock->pages[eventAddress.page] = 0;
+		set_log_pages(logBlock, 1);
 		Address dataPage = logBlock->address;
 		dataPage.valid = PAGE;
 		event.set_address(dataPage);
@@ -212,6 +244,7 @@ enum status FtlImpl_Bast::trim(Event &event)
 		lBlock->invalidate_page(returnAddress.page);
 
 		logBlock->pages[eventAddress.page] = -1; // Reset the mapping
+		set_log_pages(logBlock, logBlock->numPages - 1);
 
 		if (lBlock->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
 		{
@@ -249,32 +282,147 @@ void FtlImpl_Bast::allocate_new_logblock(LogPageBlock *logBlock, long lba, Event
 {
 	if (log_map.size() >= BAST_LOG_BLOCK_LIMIT)
 	{
-		int victim = random()%log_map.size()-1;
-		std::map<long, LogPageBlock*>::iterator it = log_map.begin();
-
-		for (int i=0;i<victim;i++)
-			it++;
-
-		long exLogicalBlock = (*it).first;
-		LogPageBlock *exLogBlock = (*it).second;
+		long exLogicalBlock = select_victim();
+		LogPageBlock *exLogBlock = log_map[exLogicalBlock];
 
+		controller.stats.latency_begin(LATENCY_MERGE, event);
 		if (!is_sequential(exLogBlock, exLogicalBlock, event))
 			random_merge(exLogBlock, exLogicalBlock, event);
+		controller.stats.latency_end(event);
 
 		controller.stats.numPageBlockToPageConversion++;
 	}
 
-	logBlock = new LogPageBlock();
+	if (log_pool.empty())
+		logBlock = new LogPageBlock();
+	else
+	{
+		logBlock = log_pool.back();
+		log_pool.pop_back();
+		logBlock->reset();
+	}
+
 	logBlock->address = Block_manager::instance()->get_free_block(LOG, event);
+	logBlock->lba = lba;
 
 	//printf("Using new log block with address: %lu Block: %u\n", logBlock->address.get_linear_address(), logBlock->address.block);
 	log_map[lba] = logBlock;
+
+	logBlock->slot = log_slots.size();
+	log_slots.push_back(logBlock);
+
+	if (BAST_VICTIM_POLICY == BAST_VICTIM_FEWEST_VALID)
+		log_valid.insert(std::make_pair(0, lba));
+
+	log_touch(logBlock);
 }
 
 void FtlImpl_Bast::dispose_logblock(LogPageBlock *logBlock, long lba)
 {
 	log_map.erase(lba);
-	delete logBlock;
+
+	// Unlink from the write order
+	if (logBlock->prev != NULL)
+		logBlock->prev->next = logBlock->next;
+	else
+		lru_head = logBlock->next;
+	if (logBlock->next != NULL)
+		logBlock->next->prev = logBlock->prev;
+	else
+		lru_tail = logBlock->prev;
+
+	// The last slot takes over the freed one
+	LogPageBlock *last = log_slots.back();
+	log_slots[logBlock->slot] = last;
+	last->slot = logBlock->slot;
+	log_slots.pop_back();
+
+	if (BAST_VICTIM_POLICY == BAST_VICTIM_FEWEST_VALID)
+		log_valid.erase(std::make_pair(logBlock->numPages, lba));
+
+	// Only live log blocks are queued, so the queue stays within the log limit
+	if (logBlock->switchQueued)
+		switch_candidates.erase(std::find(switch_candidates.begin(), switch_candidates.end(), lba));
+
+	log_pool.push_back(logBlock);
+}
+
+/*
+ * Logical block whose log block is merged next, see bast_victim_policy.
+ * Queued switch candidates are checked again when taken, as the block may
+ * have been trimmed since.
+ */
+long FtlImpl_Bast::select_victim()
+{
+	assert(lru_head != NULL);
+
+	switch (BAST_VICTIM_POLICY)
+	{
+	case BAST_VICTIM_LRU:
+		return lru_head->lba;
+	case BAST_VICTIM_FEWEST_VALID:
+		return log_valid.begin()->second;
+	case BAST_VICTIM_SWITCH_FIRST:
+		while (!switch_candidates.empty())
+		{
+			long lba = switch_candidates.front();
+			switch_candidates.pop_front();
+
+			std::map<long, LogPageBlock*>::iterator it = log_map.find(lba);
+			assert(it != log_map.end());
+
+			LogPageBlock *candidate = it->second;
+			candidate->switchQueued = false;
+			if (controller.get_num_valid(candidate->address) == BLOCK_SIZE && is_switchable(candidate))
+				return lba;
+		}
+		return lru_head->lba;
+	default:
+		return log_slots[random() % log_slots.size()]->lba;
+	}
+}
+
+/* Moves a log block to the most recently written end */
+void FtlImpl_Bast::log_touch(LogPageBlock *logBlock)
+{
+	if (logBlock == lru_tail)
+		return;
+
+	if (logBlock->prev != NULL)
+		logBlock->prev->next = logBlock->next;
+	else if (logBlock == lru_head)
+		lru_head = logBlock->next;
+	if (logBlock->next != NULL)
+		logBlock->next->prev = logBlock->prev;
+
+	logBlock->prev = lru_tail;
+	logBlock->next = NULL;
+	if (lru_tail != NULL)
+		lru_tail->next = logBlock;
+	else
+		lru_head = logBlock;
+	lru_tail = logBlock;
+}
+
+void FtlImpl_Bast::set_log_pages(LogPageBlock *logBlock, int numPages)
+{
+	if (BAST_VICTIM_POLICY == BAST_VICTIM_FEWEST_VALID)
+	{
+		log_valid.erase(std::make_pair(logBlock->numPages, logBlock->lba));
+		log_valid.insert(std::make_pair(numPages, logBlock->lba));
+	}
+
+	logBlock->numPages = numPages;
+}
+
+/* A log block holding every page at its own offset can replace the data block */
+bool FtlImpl_Bast::is_switchable(LogPageBlock *logBlock)
+{
+	for (uint i=0;i<BLOCK_SIZE;i++)
+		if (logBlock->pages[i] != (int)i)
+			return false;
+
+	return true;
 }
 
 bool FtlImpl_Bast::is_sequential(LogPageBlock* logBlock, long lba, Event &event)
@@ -285,12 +433,7 @@ bool FtlImpl_Bast::is_sequential(LogPageBlock* logBlock, long lba, Event &event)
 	 */
 
 	// Is block switch possible? i.e. log block switch
-	bool isSequential = true;
-	for (uint i=0;i<BLOCK_SIZE;i++) if (logBlock->pages[i] != (int)i)
-	{
-		isSequential = false;
-		break;
-	}
+	bool isSequential = is_switchable(logBlock);
 
 	if (isSequential)
 	{
@@ -300,7 +443,7 @@ bool FtlImpl_Bast::is_sequential(LogPageBlock* logBlock, long lba, Event &event)
 		if (data_list[lba] != -1)
 		{
 			Address a = Address(data_list[lba], PAGE);
-			Block_manager::instance()->erase_and_invalidate(event, a, DATA);
+			Block_manager::instance()->erase_and_invalidate(event, a, DATA, CAUSE_MERGE);
 		}
 
 		data_list[lba] = logBlock->address.get_linear_address();
@@ -348,10 +491,12 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 
 		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
 		readEvent.set_address(readAddress);
+		readEvent.set_cause(CAUSE_MERGE);
 		controller.issue(readEvent);
 
 		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
 		writeEvent.set_address(Address(newDataBlock.get_linear_address() + i, PAGE));
+		writeEvent.set_cause(CAUSE_MERGE);
 		writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
 		writeEvent.set_replace_address(readAddress);
 		controller.issue(writeEvent);
@@ -370,12 +515,12 @@ bool FtlImpl_Bast::random_merge(LogPageBlock *logBlock, long lba, Event &event)
 
 	// Invalidate inactive pages (LOG and DATA
 
-	Block_manager::instance()->erase_and_invalidate(event, logBlock->address, LOG);
+	Block_manager::instance()->erase_and_invalidate(event, logBlock->address, LOG, CAUSE_MERGE);
 
 	if (data_list[lba] != -1)
 	{
 		Address a = Address(data_list[lba], PAGE);
-		Block_manager::instance()->erase_and_invalidate(event, a, DATA);
+		Block_manager::instance()->erase_and_invalidate(event, a, DATA, CAUSE_MERGE);
 	}
 
 	// Update mapping
@@ -393,6 +538,7 @@ void FtlImpl_Bast::update_map_block(Event &event)
 	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
 	writeEvent.set_address(Address(0, PAGE));
 	writeEvent.set_noop(true);
+	writeEvent.set_cause(CAUSE_MAPPING);
 
 	controller.issue(writeEvent);
 
@@ -86,10 +86,10 @@ enum status FtlImpl_BDftl::read(Event &event)
 	} else { // DFTL lookup
 		resolve_mapping(event, false);
 
-		MPage current = trans_map[dlpn];
+		long ppn = trans_map[dlpn];
 
-		if (current.ppn != -1)
-			event.set_address(Address(current.ppn, PAGE));
+		if (ppn != -1)
+			event.set_address(Address(ppn, PAGE));
 		else
 		{
 			event.set_address(Address(0, PAGE));
@@ -156,17 +156,15 @@ enum status FtlImpl_BDftl::write(Event &event)
 					if (b->get_state(i) != VALID)
 						continue;
 
-					MPage current = trans_map[startAdr + i];
-
-					if (current.ppn != -1)
+					if (trans_map[startAdr + i] != -1)
 					{
-						update_translation_map(current, block_map[dlbn].pbn+i);
-						current.create_ts = event.get_start_time();
-						current.modified_ts = event.get_start_time();
-						current.cached = true;
-						trans_map.replace(trans_map.begin()+startAdr+i, current);
+						update_translation_map(startAdr + i, block_map[dlbn].pbn+i);
 
-						cmt++;
+						long index = cmt_find(startAdr + i);
+						if (index != -1)
+							cmt_entries[index].dirty = false;
+						else
+							cmt_insert(startAdr + i, false, false);
 
 						event.incr_time_taken(RAM_WRITE_DELAY);
 						controller.stats.numMemoryWrite++;
@@ -203,19 +201,18 @@ enum status FtlImpl_BDftl::write(Event &event)
 		long free_page = get_free_biftl_page(event);
 		resolve_mapping(event, true);
 
-		MPage current = trans_map[dlpn];
+		long ppn = trans_map[dlpn];
 
-		Address a = Address(current.ppn, PAGE);
+		Address a = Address(ppn, PAGE);
 
-		if (current.ppn != -1)
+		if (ppn != -1)
 			event.set_replace_address(a);
 
 
-		update_translation_map(current, free_page);
-		trans_map.replace(trans_map.begin()+dlpn, current);
+		update_translation_map(dlpn, free_page);
 
 		// Finish DFTL logic
-		event.set_address(Address(current.ppn, PAGE));
+		event.set_address(Address(free_page, PAGE));
 	}
 
 	controller.stats.numMemoryRead += 3; // Block-level lookup + range check + optimal check
@@ -291,18 +288,17 @@ enum status FtlImpl_BDftl::trim(Event &event)
 		}
 	} else { // DFTL lookup
 
-		MPage current = trans_map[dlpn];
-		if (current.ppn != -1)
+		long ppn = trans_map[dlpn];
+		if (ppn != -1)
 		{
-			Address address = Address(current.ppn, PAGE);
+			Address address = Address(ppn, PAGE);
 			Block *block = controller.get_block_pointer(address);
 			block->invalidate_page(address.page);
 
 			evict_specific_page_from_cache(event, dlpn);
 
 			// Update translation map to default values.
-			update_translation_map(current, -1);
-			trans_map.replace(trans_map.begin()+dlpn, current);
+			update_translation_map(dlpn, -1);
 
 			event.incr_time_taken(RAM_READ_DELAY);
 			event.incr_time_taken(RAM_WRITE_DELAY);
@@ -342,6 +338,12 @@ enum status FtlImpl_BDftl::trim(Event &event)
 
 void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 {
+	if (block->get_block_type() == MAP)
+	{
+		cleanup_translation_block(event, block);
+		return;
+	}
+
 	std::map<long, long> invalidated_translation;
 	/*
 	 * 1. Copy only valid pages in the victim block to the current data block
@@ -358,6 +360,7 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 			// Set up events.
 			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
 			readEvent.set_address(Address(block->get_physical_address()+i, PAGE));
+			readEvent.set_cause(CAUSE_GC);
 
 			// Execute read event
 			if (controller.issue(readEvent) == FAILURE)
@@ -367,6 +370,7 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 			Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
 			Address dataBlockAddress = Address(get_free_data_page(event, false), PAGE);
 			writeEvent.set_address(dataBlockAddress);
+			writeEvent.set_cause(CAUSE_GC);
 			writeEvent.set_replace_address(Address(block->get_physical_address()+i, PAGE));
 
 			// Setup the write event to read from the right place.
@@ -390,40 +394,16 @@ void FtlImpl_BDftl::cleanup_block(Event &event, Block *block)
 			controller.stats.numWLRead++;
 			controller.stats.numWLWrite++;
 			controller.stats.numMemoryRead++; // Block->get_state(i) == VALID
-			controller.stats.numMemoryWrite =+ 3; // GTD Update (2) + translation invalidate (1)
+			controller.stats.numMemoryWrite += 3; // GTD Update (2) + translation invalidate (1)
 		}
 	}
 
 	/*
 	 * Perform batch update on the marked translation pages
-	 * 1. Update GDT and CMT if necessary.
-	 * 2. Simulate translation page updates.
+	 * 1. Update GDT.
+	 * 2. Write back every translation page touched, once.
 	 */
-
-	std::map<long, bool> dirtied_translation_pages;
-
-	for (std::map<long, long>::const_iterator i = invalidated_translation.begin(); i!=invalidated_translation.end(); ++i)
-	{
-		long real_vpn = (*i).first;
-		long newppn = (*i).second;
-
-		// Update translation map ( it also updates the CMT, as it is stored inside the GDT )
-		MPage current = trans_map[real_vpn];
-
-		update_translation_map(current, newppn);
-
-		if (current.cached)
-			current.modified_ts = event.get_start_time();
-		else
-		{
-			current.modified_ts = event.get_start_time();
-			current.create_ts = event.get_start_time();
-			current.cached = true;
-			cmt++;
-		}
-
-		trans_map.replace(trans_map.begin()+real_vpn, current);
-	}
+	update_translation_pages(event, invalidated_translation);
 }
 
 // Returns true if the next page is in a new block
@@ -59,14 +59,14 @@ enum status FtlImpl_Dftl::read(Event &event)
 	uint dlpn = event.get_logical_address();
 
 	resolve_mapping(event, false);
-	MPage current = trans_map[dlpn];
-	if (current.ppn == -1)
+	long ppn = trans_map[dlpn];
+	if (ppn == -1)
 	{
 		event.set_address(Address(0, PAGE));
 		event.set_noop(true);
 	}
 	else
-		event.set_address(Address(current.ppn, PAGE));
+		event.set_address(Address(ppn, PAGE));
 
 
 	controller.stats.numFTLRead++;
@@ -78,19 +78,18 @@ enum status FtlImpl_Dftl::write(Event &event)
 {
 	uint dlpn = event.get_logical_address();
 
-	resolve_mapping(event, true);
-
 	// Important order. As get_free_data_page might change current.
 	long free_page = get_free_data_page(event);
+	resolve_mapping(event, true);
 
-	MPage current = trans_map[dlpn];
+	long ppn = trans_map[dlpn];
 
-	Address a = Address(current.ppn, PAGE);
-	if (current.ppn != -1)
+	Address a = Address(ppn, PAGE);
+	if (ppn != -1)
 		event.set_replace_address(a);
 
-	update_translation_map(current, free_page);
-	trans_map.replace(trans_map.begin()+dlpn, current);
+	update_translation_map(dlpn, free_page);
+	cmt_keep_dirty(event, dlpn);
 
 	Address b = Address(free_page, PAGE);
 	event.set_address(b);
@@ -106,19 +105,17 @@ enum status FtlImpl_Dftl::trim(Event &event)
 
 	event.set_address(Address(0, PAGE));
 
-	MPage current = trans_map[dlpn];
+	long ppn = trans_map[dlpn];
 
-	if (current.ppn != -1)
+	if (ppn != -1)
 	{
-		Address address = Address(current.ppn, PAGE);
+		Address address = Address(ppn, PAGE);
 		Block *block = controller.get_block_pointer(address);
 		block->invalidate_page(address.page);
 
 		evict_specific_page_from_cache(event, dlpn);
 
-		update_translation_map(current, -1);
-
-		trans_map.replace(trans_map.begin()+dlpn, current);
+		update_translation_map(dlpn, -1);
 	}
 
 	controller.stats.numFTLTrim++;
@@ -128,6 +125,12 @@ enum status FtlImpl_Dftl::trim(Event &event)
 
 void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 {
+	if (block->get_block_type() == MAP)
+	{
+		cleanup_translation_block(event, block);
+		return;
+	}
+
 	std::map<long, long> invalidated_translation;
 	/*
 	 * 1. Copy only valid pages in the victim block to the current data block
@@ -144,6 +147,7 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 			// Set up events.
 			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
 			readEvent.set_address(Address(block->get_physical_address()+i, PAGE));
+			readEvent.set_cause(CAUSE_GC);
 
 			// Execute read event
 			if (controller.issue(readEvent) == FAILURE)
@@ -154,6 +158,7 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 			Address dataBlockAddress = Address(get_free_data_page(event, false), PAGE);
 
 			writeEvent.set_address(dataBlockAddress);
+			writeEvent.set_cause(CAUSE_GC);
 
 			writeEvent.set_replace_address(Address(block->get_physical_address()+i, PAGE));
 
@@ -178,41 +183,16 @@ void FtlImpl_Dftl::cleanup_block(Event &event, Block *block)
 			controller.stats.numWLRead++;
 			controller.stats.numWLWrite++;
 			controller.stats.numMemoryRead++; // Block->get_state(i) == VALID
-			controller.stats.numMemoryWrite =+ 3; // GTD Update (2) + translation invalidate (1)
+			controller.stats.numMemoryWrite += 3; // GTD Update (2) + translation invalidate (1)
 		}
 	}
 
 	/*
 	 * Perform batch update on the marked translation pages
-	 * 1. Update GDT and CMT if necessary.
-	 * 2. Simulate translation page updates.
+	 * 1. Update GDT.
+	 * 2. Write back every translation page touched, once.
 	 */
-
-	std::map<long, bool> dirtied_translation_pages;
-
-	for (std::map<long, long>::const_iterator i = invalidated_translation.begin(); i!=invalidated_translation.end(); ++i)
-	{
-		long real_vpn = (*i).first;
-		long newppn = (*i).second;
-
-		// Update translation map ( it also updates the CMT, as it is stored inside the GDT )
-		MPage current = trans_map[real_vpn];
-
-		update_translation_map(current, newppn);
-
-		if (current.cached)
-			current.modified_ts = event.get_start_time();
-		else
-		{
-			current.modified_ts = event.get_start_time();
-			current.create_ts = event.get_start_time();
-			current.cached = true;
-			cmt++;
-		}
-
-		trans_map.replace(trans_map.begin()+real_vpn, current);
-	}
-
+	update_translation_pages(event, invalidated_translation);
 }
 
 void FtlImpl_Dftl::print_ftl_statistics()
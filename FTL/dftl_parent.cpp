@@ -24,6 +24,14 @@
  * Global Translation Directory GTD (Maintained in memory)
  * Cached Mapping Table CMT (Uses LRU to pick victim)
  *
+ * The GMT is a flat array of physical page numbers.  The CMT is a bounded
+ * hash table over the cached logical pages with an intrusive LRU list, so
+ * hits and evictions take constant time whatever the size of the device.
+ *
+ * Translation pages are stored in MAP blocks from the Block_manager and
+ * updated out of place; the GTD tracks where each one currently lives, and
+ * MAP blocks are garbage collected like data blocks.
+ *
  * Dlpn/Dppn Data Logical/Physical Page Number
  * Mlpn/Mppn Translation Logical/Physical Page Number
  */
@@ -36,29 +44,10 @@
 #include <vector>
 #include <queue>
 #include <iostream>
-#include <limits>
 #include "ssd.h"
 
 using namespace ssd;
 
-FtlImpl_DftlParent::MPage::MPage(long vpn)
-{
-	this->vpn = vpn;
-	this->ppn = -1;
-	this->create_ts = -1;
-	this->modified_ts = -1;
-	this->last_visited_time = -1;
-	this->cached = false;
-}
-
-double FtlImpl_DftlParent::mpage_last_visited_time_compare(const FtlImpl_DftlParent::MPage& mpage)
-{
-	if (!mpage.cached)
-		return std::numeric_limits<double>::max();
-
-	return mpage.last_visited_time;
-}
-
 FtlImpl_DftlParent::FtlImpl_DftlParent(Controller &controller):
 	FtlParent(controller)
 {
@@ -71,7 +60,8 @@ FtlImpl_DftlParent::FtlImpl_DftlParent(Controller &controller):
 	addressSize = log(NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE)/log(2);
 
 	// Find required number of bits for block size
-	addressPerPage = (PAGE_SIZE/ceil(addressSize / 8.0)); // 8 bits per byte
+	entryBytes = ceil(addressSize / 8.0); // 8 bits per byte
+	addressPerPage = PAGE_SIZE / entryBytes;
 
 	printf("Total required bits for representation: Address size: %i Total per page: %i \n", addressSize, addressPerPage);
 
@@ -81,42 +71,316 @@ FtlImpl_DftlParent::FtlImpl_DftlParent(Controller &controller):
 	// Initialise block mapping table.
 	uint ssdSize = NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE;
 
-	trans_map.reserve(ssdSize);
+	trans_map = new long[ssdSize];
 	for (uint i=0;i<ssdSize;i++)
-		trans_map.push_back(MPage(i));
+		trans_map[i] = -1;
 
 	reverse_trans_map = new long[ssdSize];
+
+	numTranslationPages = (ssdSize + addressPerPage - 1) / addressPerPage;
+	gtd = new long[numTranslationPages];
+	for (long i=0;i<numTranslationPages;i++)
+		gtd[i] = -1;
+
+	tpage_seq.assign(numTranslationPages, 0);
+
+	// Initialise the CMT, one bucket per entry rounded up to a power of two.
+	uint numBuckets = 1;
+	while (numBuckets < totalCMTentries)
+		numBuckets <<= 1;
+	cmt_buckets.assign(numBuckets, -1);
+	cmt_entries.reserve(totalCMTentries);
+	cmt_free = -1;
+	cmt_lru_head = -1;
+	cmt_lru_tail = -1;
+}
+
+long FtlImpl_DftlParent::cmt_find(long vpn) const
+{
+	for (long i = cmt_buckets[vpn & (cmt_buckets.size() - 1)]; i != -1; i = cmt_entries[i].hash_next)
+		if (cmt_entries[i].vpn == vpn)
+			return i;
+	return -1;
+}
+
+/* Add a mapping to the CMT.  Hot entries go to the most recently used end of
+ * the LRU list, cold ones (not referenced by the host) are next in line for
+ * eviction. */
+long FtlImpl_DftlParent::cmt_insert(long vpn, bool dirty, bool hot)
+{
+	long index;
+
+	assert(cmt_find(vpn) == -1);
+
+	if (cmt_free != -1)
+	{
+		index = cmt_free;
+		cmt_free = cmt_entries[index].hash_next;
+	}
+	else
+	{
+		index = cmt_entries.size();
+		cmt_entries.push_back(CmtEntry());
+	}
+
+	CmtEntry &entry = cmt_entries[index];
+	long &bucket = cmt_buckets[vpn & (cmt_buckets.size() - 1)];
+	entry.vpn = vpn;
+	entry.dirty = false;
+	entry.hash_next = bucket;
+	bucket = index;
+
+	cmt_link(index, hot);
+
+	if (dirty)
+		cmt_set_dirty(index);
+
+	cmt++;
+	return index;
+}
+
+void FtlImpl_DftlParent::cmt_remove(long index)
+{
+	CmtEntry &entry = cmt_entries[index];
+
+	long *link = &cmt_buckets[entry.vpn & (cmt_buckets.size() - 1)];
+	while (*link != index)
+		link = &cmt_entries[*link].hash_next;
+	*link = entry.hash_next;
+
+	cmt_unlink(index);
+
+	entry.hash_next = cmt_free;
+	cmt_free = index;
+
+	cmt--;
+}
+
+void FtlImpl_DftlParent::cmt_link(long index, bool hot)
+{
+	CmtEntry &entry = cmt_entries[index];
+
+	if (hot)
+	{
+		entry.lru_prev = cmt_lru_tail;
+		entry.lru_next = -1;
+		if (cmt_lru_tail != -1)
+			cmt_entries[cmt_lru_tail].lru_next = index;
+		else
+			cmt_lru_head = index;
+		cmt_lru_tail = index;
+	}
+	else
+	{
+		entry.lru_prev = -1;
+		entry.lru_next = cmt_lru_head;
+		if (cmt_lru_head != -1)
+			cmt_entries[cmt_lru_head].lru_prev = index;
+		else
+			cmt_lru_tail = index;
+		cmt_lru_head = index;
+	}
+}
+
+void FtlImpl_DftlParent::cmt_unlink(long index)
+{
+	CmtEntry &entry = cmt_entries[index];
+
+	if (entry.lru_prev != -1)
+		cmt_entries[entry.lru_prev].lru_next = entry.lru_next;
+	else
+		cmt_lru_head = entry.lru_next;
+	if (entry.lru_next != -1)
+		cmt_entries[entry.lru_next].lru_prev = entry.lru_prev;
+	else
+		cmt_lru_tail = entry.lru_prev;
+}
+
+/* Move an entry to the most recently used end of the LRU list */
+void FtlImpl_DftlParent::cmt_touch(long index)
+{
+	if (index == cmt_lru_tail)
+		return;
+
+	cmt_unlink(index);
+	cmt_link(index, true);
+}
+
+/* The entry to evict next */
+long FtlImpl_DftlParent::cmt_victim()
+{
+	return cmt_lru_head;
+}
+
+void FtlImpl_DftlParent::cmt_set_dirty(long index)
+{
+	CmtEntry &entry = cmt_entries[index];
+	entry.dirty = true;
+	entry.dirty_seq = tpage_seq[entry.vpn / addressPerPage];
+}
+
+/* Marks the mapping a host write just installed dirty.  Anything between
+ * resolving the mapping and installing it (GC behind the data page
+ * allocation, prefetching evictions) may have written back its translation
+ * page or evicted the entry. */
+void FtlImpl_DftlParent::cmt_keep_dirty(Event &event, long vpn)
+{
+	long index = cmt_find(vpn);
+
+	if (index != -1)
+	{
+		cmt_set_dirty(index);
+		return;
+	}
+
+	evict_page_from_cache(event);
+	cmt_insert(vpn, true, true);
+}
+
+/* Writing back a translation page cleans every cached mapping it holds at
+ * once by moving the page to the next generation. */
+bool FtlImpl_DftlParent::cmt_is_dirty(long index) const
+{
+	const CmtEntry &entry = cmt_entries[index];
+	return entry.dirty && entry.dirty_seq == tpage_seq[entry.vpn / addressPerPage];
 }
 
 void FtlImpl_DftlParent::consult_GTD(long dlpn, Event &event)
 {
-	// Simulate that we goto translation map and read the mapping page.
+	long mppn = gtd[dlpn / addressPerPage];
+
+	// Nothing has been mapped in this translation page yet
+	if (mppn == -1)
+		return;
+
+	controller.stats.latency_begin(LATENCY_MAPPING, event);
+
+	// Read the translation page holding the mapping.
 	Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
-	readEvent.set_address(Address(0, PAGE));
-	readEvent.set_noop(true);
+	readEvent.set_address(Address(mppn, PAGE));
+	readEvent.set_cause(CAUSE_MAPPING);
 
 	if (controller.issue(readEvent) == FAILURE) { assert(false);}
 	//event.consolidate_metaevent(readEvent);
 	event.incr_time_taken(readEvent.get_time_taken());
 	controller.stats.numFTLRead++;
+
+	controller.stats.latency_end(event);
+}
+
+/* Write a translation page out of place.  Unless it has never been written,
+ * the current copy is read first to merge the cached mappings into the
+ * uncached ones, and invalidated by the write. */
+void FtlImpl_DftlParent::write_translation_page(Event &event, long mlpn)
+{
+	long mppn = gtd[mlpn];
+
+	if (mppn != -1)
+	{
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+		readEvent.set_address(Address(mppn, PAGE));
+		readEvent.set_cause(CAUSE_MAPPING);
+
+		if (controller.issue(readEvent) == FAILURE) { assert(false);}
+
+		event.incr_time_taken(readEvent.get_time_taken());
+		controller.stats.numFTLRead++;
+	}
+
+	long free_page = get_free_translation_page(event);
+
+	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
+	writeEvent.set_address(Address(free_page, PAGE));
+	if (gtd[mlpn] != -1)
+		writeEvent.set_replace_address(Address(gtd[mlpn], PAGE));
+	writeEvent.set_cause(CAUSE_MAPPING);
+
+	if (controller.issue(writeEvent) == FAILURE) { assert(false);}
+
+	event.incr_time_taken(writeEvent.get_time_taken());
+	controller.stats.numFTLWrite++;
+	controller.stats.numGCWrite++;
+
+	gtd[mlpn] = free_page;
+	reverse_trans_map[free_page] = mlpn;
 }
 
-void FtlImpl_DftlParent::reset_MPage(FtlImpl_DftlParent::MPage &mpage)
+/* Bring the mappings GC moved (logical page -> new physical page) up to
+ * date on flash with one read-modify-write per translation page they fall
+ * in.  The write-back cleans every cached entry of the page; moved mappings
+ * that are not cached stay out of the CMT. */
+void FtlImpl_DftlParent::update_translation_pages(Event &event, const std::map<long, long> &moved)
 {
-	mpage.create_ts = -2;
-	mpage.modified_ts = -2;
-	mpage.last_visited_time = -2;
+	for (std::map<long, long>::const_iterator i = moved.begin(); i != moved.end(); ++i)
+	{
+		long vpn = (*i).first;
+		long mlpn = vpn / addressPerPage;
+
+		update_translation_map(vpn, (*i).second);
+
+		if (cmt_find(vpn) != -1)
+			controller.stats.numMemoryWrite++;
+
+		std::map<long, long>::const_iterator next = i;
+		++next;
+		if (next == moved.end() || (*next).first / addressPerPage != mlpn)
+		{
+			tpage_seq[mlpn]++;
+			write_translation_page(event, mlpn);
+		}
+	}
 }
 
-bool FtlImpl_DftlParent::lookup_CMT(long dlpn, Event &event)
+/* Move the valid translation pages of a MAP block picked by the GC */
+void FtlImpl_DftlParent::cleanup_translation_block(Event &event, Block *block)
 {
-	if (!trans_map[dlpn].cached)
-		return false;
+	for (uint i=0;i<BLOCK_SIZE;i++)
+	{
+		assert(block->get_state(i) != EMPTY);
+
+		if (block->get_state(i) != VALID)
+			continue;
+
+		long mppn = block->get_physical_address()+i;
+		long mlpn = reverse_trans_map[mppn];
+		assert(gtd[mlpn] == mppn);
+
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+		readEvent.set_address(Address(mppn, PAGE));
+		readEvent.set_cause(CAUSE_GC);
+
+		if (controller.issue(readEvent) == FAILURE) { assert(false);}
+
+		long free_page = get_free_translation_page(event);
+
+		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
+		writeEvent.set_address(Address(free_page, PAGE));
+		writeEvent.set_replace_address(Address(mppn, PAGE));
+		writeEvent.set_cause(CAUSE_GC);
+
+		if (controller.issue(writeEvent) == FAILURE) { assert(false);}
+
+		event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+
+		gtd[mlpn] = free_page;
+		reverse_trans_map[free_page] = mlpn;
+
+		controller.stats.numFTLRead++;
+		controller.stats.numFTLWrite++;
+		controller.stats.numMemoryWrite++; // GTD update
+	}
+}
+
+long FtlImpl_DftlParent::lookup_CMT(long dlpn, Event &event)
+{
+	long index = cmt_find(dlpn);
+	if (index == -1)
+		return -1;
 
 	event.incr_time_taken(RAM_READ_DELAY);
 	controller.stats.numMemoryRead++;
 
-	return true;
+	return index;
 }
 
 long FtlImpl_DftlParent::get_free_data_page(Event &event)
@@ -137,9 +401,21 @@ long FtlImpl_DftlParent::get_free_data_page(Event &event, bool insert_events)
 	return currentDataPage;
 }
 
+long FtlImpl_DftlParent::get_free_translation_page(Event &event)
+{
+	if (currentTranslationPage == -1 || currentTranslationPage % BLOCK_SIZE == BLOCK_SIZE -1)
+		currentTranslationPage = Block_manager::instance()->get_free_block(MAP, event).get_linear_address();
+	else
+		currentTranslationPage++;
+
+	return currentTranslationPage;
+}
+
 FtlImpl_DftlParent::~FtlImpl_DftlParent(void)
 {
+	delete[] trans_map;
 	delete[] reverse_trans_map;
+	delete[] gtd;
 }
 
 void FtlImpl_DftlParent::resolve_mapping(Event &event, bool isWrite)
@@ -152,17 +428,14 @@ void FtlImpl_DftlParent::resolve_mapping(Event &event, bool isWrite)
 	 * 5. Add mapping to CMT
 	 */
 	//printf("%i\n", cmt);
-	if (lookup_CMT(event.get_logical_address(), event))
+	long index = lookup_CMT(dlpn, event);
+	if (index != -1)
 	{
 		controller.stats.numCacheHits++;
 
-		MPage current = trans_map[dlpn];
 		if (isWrite)
-		{
-			current.modified_ts = event.get_start_time();			
-		}
-		current.last_visited_time = event.get_start_time();
-		trans_map.replace(trans_map.begin()+dlpn, current);
+			cmt_set_dirty(index);
+		cmt_touch(index);
 
 		// evict_page_from_cache(event);    // no need to evict page from cache
 	} else {
@@ -172,117 +445,61 @@ void FtlImpl_DftlParent::resolve_mapping(Event &event, bool isWrite)
 
 		consult_GTD(dlpn, event);
 
-		MPage current = trans_map[dlpn];
-		current.modified_ts = event.get_start_time();
-		current.last_visited_time = event.get_start_time();
-		if (isWrite)
-			current.modified_ts++;
-		current.create_ts = event.get_start_time();
-		current.cached = true;
-		trans_map.replace(trans_map.begin()+dlpn, current);
-
-		cmt++;
+		cmt_insert(dlpn, isWrite, true);
 	}
+
+	// RAM holding the CMT and the GTD
+	controller.stats.numMemoryTranslation = (cmt + numTranslationPages) * entryBytes;
 }
 
 void FtlImpl_DftlParent::evict_page_from_cache(Event &event)
 {
-	while (cmt >= totalCMTentries)
-	{
-		// Find page to evict
-		MpageByLastVisited::iterator evictit = boost::multi_index::get<1>(trans_map).begin();
-		MPage evictPage = *evictit;
-
-		assert(evictPage.cached && evictPage.create_ts >= 0 && evictPage.modified_ts >= 0);
-
-		if (evictPage.create_ts != evictPage.modified_ts)
-		{
-			// Evict page
-			// Inform the ssd model that it should invalidate the previous page.
-			// Calculate the start address of the translation page.
-			int vpnBase = evictPage.vpn - evictPage.vpn % addressPerPage;
-
-			for (int i=0;i<addressPerPage;i++)
-			{
-				MPage cur = trans_map[vpnBase+i];
-				if (cur.cached)
-				{
-					cur.create_ts = cur.modified_ts;
-					trans_map.replace(trans_map.begin()+vpnBase+i, cur);
-				}
-			}
-
-			// Simulate the write to translate page
-			Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
-			write_event.set_address(Address(0, PAGE));
-			write_event.set_noop(true);
-
-			if (controller.issue(write_event) == FAILURE) {	assert(false);}
-
-			event.incr_time_taken(write_event.get_time_taken());
-			controller.stats.numFTLWrite++;
-			controller.stats.numGCWrite++;
-		}
+	controller.stats.latency_begin(LATENCY_MAPPING, event);
 
-		// Remove page from cache.
-		cmt--;
+	while (cmt >= totalCMTentries)
+		evict_entry(event, cmt_victim());
 
-		evictPage.cached = false;
-		reset_MPage(evictPage);
-		trans_map.replace(trans_map.begin()+evictPage.vpn, evictPage);
-	}
+	controller.stats.latency_end(event);
 }
 
 void FtlImpl_DftlParent::evict_specific_page_from_cache(Event &event, long lba)
 {
-		// Find page to evict
-		MPage evictPage = trans_map[lba];
+	long index = cmt_find(lba);
+	if (index == -1)
+		return;
 
-		if (!evictPage.cached)
-			return;
+	controller.stats.latency_begin(LATENCY_MAPPING, event);
+	evict_entry(event, index);
+	controller.stats.latency_end(event);
+}
 
-		assert(evictPage.cached && evictPage.create_ts >= 0 && evictPage.modified_ts >= 0);
+/* Remove a mapping from the CMT, writing back its translation page first
+ * if it is dirty */
+void FtlImpl_DftlParent::evict_entry(Event &event, long index)
+{
+	assert(index != -1);
 
-		if (evictPage.create_ts != evictPage.modified_ts)
-		{
-			// Evict page
-			// Inform the ssd model that it should invalidate the previous page.
-			// Calculate the start address of the translation page.
-			int vpnBase = evictPage.vpn - evictPage.vpn % addressPerPage;
-
-			for (int i=0;i<addressPerPage;i++)
-			{
-				MPage cur = trans_map[vpnBase+i];
-				if (cur.cached)
-				{
-					cur.create_ts = cur.modified_ts;
-					trans_map.replace(trans_map.begin()+vpnBase+i, cur);
-				}
-			}
-
-			// Simulate the write to translate page
-			Event write_event = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
-			write_event.set_address(Address(0, PAGE));
-			write_event.set_noop(true);
-
-			if (controller.issue(write_event) == FAILURE) {	assert(false);}
-
-			event.incr_time_taken(write_event.get_time_taken());
-			controller.stats.numFTLWrite++;
-			controller.stats.numGCWrite++;
-		}
+	if (cmt_is_dirty(index))
+	{
+		// The write back cleans every cached mapping of the translation page.
+		long mlpn = cmt_entries[index].vpn / addressPerPage;
+		tpage_seq[mlpn]++;
 
-		// Remove page from cache.
-		cmt--;
+		write_translation_page(event, mlpn);
+	}
 
-		evictPage.cached = false;
-		reset_MPage(evictPage);
-		trans_map.replace(trans_map.begin()+evictPage.vpn, evictPage);
+	// Remove page from cache.
+	cmt_remove(index);
+}
 
+long FtlImpl_DftlParent::get_num_cached_mappings() const
+{
+	return cmt;
 }
 
-void FtlImpl_DftlParent::update_translation_map(FtlImpl_DftlParent::MPage &mpage, long ppn)
+void FtlImpl_DftlParent::update_translation_map(long vpn, long ppn)
 {
-	mpage.ppn = ppn;
-	reverse_trans_map[ppn] = mpage.vpn;
+	trans_map[vpn] = ppn;
+	if (ppn != -1)
+		reverse_trans_map[ppn] = vpn;
 }
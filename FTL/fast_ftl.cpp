@@ -17,6 +17,12 @@
  *
  * Implementation of the FAST FTL described in the paper
  * "A Log buffer-Based Flash Translation Layer Using Fully-Associative Sector Translation by Lee et. al."
+ *
+ * The paper's single SW log block is generalised to FAST_SEQUENTIAL_LOG_LIMIT
+ * of them so interleaved sequential streams do not evict each other.  A
+ * stream is a run of in-order writes starting at offset 0 of a logical
+ * block; when it reaches the next logical block it keeps its SW log block
+ * (see select_sequential).
  */
 
 #include <new>
@@ -45,9 +51,13 @@ FtlImpl_Fast::FtlImpl_Fast(Controller &controller):
 
 	pin_list = new bool[NUMBER_OF_ADDRESSABLE_BLOCKS*BLOCK_SIZE];
 
+	LogIndex empty = {NULL, 0};
+	log_index.assign((ulong) NUMBER_OF_ADDRESSABLE_BLOCKS*BLOCK_SIZE, empty);
+
 	// SW
-	sequential_offset = 0;
-	sequential_logicalblock_address = -1;
+	SequentialLog unused = {-1, Address(), 0, 0};
+	sequential_logs.assign(FAST_SEQUENTIAL_LOG_LIMIT, unused);
+	sequential_clock = 0;
 
 	log_page_next = 0;
 
@@ -90,36 +100,20 @@ enum status FtlImpl_Fast::read(Event &event)
 	long lookupBlock = (event.get_logical_address() >> addressShift);
 	uint lbnOffset = event.get_logical_address() % BLOCK_SIZE;
 
-	Address eventAddress = Address(event.get_logical_address(), PAGE);
-
-	LogPageBlock *currentBlock = log_pages;
+	const LogIndex &entry = log_index[event.get_logical_address()];
 
-	bool found = false;
-	while (!found && currentBlock != NULL)
+	if (entry.block != NULL)
 	{
-		for (int i=0;i<currentBlock->numPages;i++)
-		{
-			//event.incr_time_taken(RAM_READ_DELAY);
-
-			if (currentBlock->aPages[i] == (long)event.get_logical_address())
-			{
-				Address readAddress = Address(currentBlock->address.get_linear_address() + i, PAGE);
-				event.set_address(readAddress);
-
-				// Cancel the while and for loop
-				found = true;
-				break;
-			}
-		}
-
-		currentBlock = currentBlock->next;
+		Address readAddress = Address(entry.block->address.get_linear_address() + entry.offset, PAGE);
+		event.set_address(readAddress);
 	}
-
-	if (!found)
+	else
 	{
-		if (sequential_logicalblock_address == lookupBlock && sequential_offset > lbnOffset)
+		int seq = find_sequential(lookupBlock);
+
+		if (seq != -1 && sequential_logs[seq].offset > lbnOffset)
 		{
-			event.set_address(Address(sequential_address.get_linear_address() + lbnOffset, PAGE));
+			event.set_address(Address(sequential_logs[seq].address.get_linear_address() + lbnOffset, PAGE));
 		}
 		else if (data_list[lookupBlock] != -1) // If page is in the data block
 		{
@@ -147,6 +141,9 @@ enum status FtlImpl_Fast::write(Event &event)
 
 	pin_list[event.get_logical_address()] = true;
 
+	// Only a copy appended to the RW log blocks is indexed (see write_to_log_block)
+	log_index[event.get_logical_address()].block = NULL;
+
 	uint lbnOffset = event.get_logical_address() % BLOCK_SIZE;
 
 	// if a collision occurs at offset of the data block of pbn.
@@ -191,50 +188,40 @@ enum status FtlImpl_Fast::trim(Event &event)
 	long lookupBlock = (event.get_logical_address() >> addressShift);
 	uint lbnOffset = event.get_logical_address() % BLOCK_SIZE;
 
-	Address eventAddress = Address(event.get_logical_address(), PAGE);
-
-	LogPageBlock *currentBlock = log_pages;
+	LogIndex &entry = log_index[event.get_logical_address()];
 
-	bool found = false;
-	while (!found && currentBlock != NULL)
+	if (entry.block != NULL)
 	{
-		for (int i=0;i<currentBlock->numPages;i++)
-		{
-			if (currentBlock->aPages[i] == (long)event.get_logical_address())
-			{
-				Address address = Address(currentBlock->address.get_linear_address() + i, PAGE);
-				Block *block = controller.get_block_pointer(address);
-				block->invalidate_page(address.page);
+		LogPageBlock *currentBlock = entry.block;
 
-				currentBlock->aPages[i] = -1;
+		Address address = Address(currentBlock->address.get_linear_address() + entry.offset, PAGE);
+		Block *block = controller.get_block_pointer(address);
+		block->invalidate_page(address.page);
 
-				if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
-				{
-					Block_manager::instance()->erase_and_invalidate(event, currentBlock->address, LOG);
-					data_list[lookupBlock] = -1;
-				}
+		currentBlock->aPages[entry.offset] = -1;
+		entry.block = NULL;
 
-				// Cancel the while and for loop
-				found = true;
-				break;
-			}
+		if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
+		{
+			Block_manager::instance()->erase_and_invalidate(event, currentBlock->address, LOG);
+			data_list[lookupBlock] = -1;
 		}
-
-		currentBlock = currentBlock->next;
 	}
-
-	if (!found)
+	else
 	{
-		if (sequential_logicalblock_address == lookupBlock && sequential_offset > lbnOffset)
+		int seq = find_sequential(lookupBlock);
+
+		if (seq != -1 && sequential_logs[seq].offset > lbnOffset)
 		{
-			Address address = Address(sequential_address.get_linear_address() + lbnOffset, PAGE);
+			Address address = Address(sequential_logs[seq].address.get_linear_address() + lbnOffset, PAGE);
 			Block *block = controller.get_block_pointer(address);
 			block->invalidate_page(address.page);
 
 			if (block->get_state() == INACTIVE) // All pages invalid, force an erase. PTRIM style.
 			{
 				Block_manager::instance()->erase_and_invalidate(event, address, LOG);
-				sequential_logicalblock_address = -1;
+				sequential_logs[seq].lba = -1;
+				sequential_logs[seq].offset = 0;
 			}
 
 		}
@@ -265,23 +252,62 @@ enum status FtlImpl_Fast::trim(Event &event)
 	return controller.issue(event);
 }
 
-void FtlImpl_Fast::switch_sequential(Event &event)
+/* SW log block filling the given logical block, -1 if none */
+int FtlImpl_Fast::find_sequential(long logicalBlockAddress)
+{
+	for (uint i=0;i<sequential_logs.size();i++)
+		if (sequential_logs[i].lba == logicalBlockAddress)
+			return i;
+
+	return -1;
+}
+
+/*
+ * SW log block for a stream starting at the given logical block: the one
+ * whose stream was filling the logical block before it, else an unused one,
+ * else the least recently written.
+ */
+int FtlImpl_Fast::select_sequential(long logicalBlockAddress)
+{
+	int victim = 0;
+
+	for (uint i=0;i<sequential_logs.size();i++)
+	{
+		if (logicalBlockAddress > 0 && sequential_logs[i].lba == logicalBlockAddress - 1)
+			return i;
+
+		if (sequential_logs[victim].lba != -1 && (sequential_logs[i].lba == -1 || sequential_logs[i].lastWrite < sequential_logs[victim].lastWrite))
+			victim = i;
+	}
+
+	return victim;
+}
+
+void FtlImpl_Fast::open_sequential(Event &event, SequentialLog &log, long logicalBlockAddress)
+{
+	log.offset = 1;
+	log.address = Block_manager::instance()->get_free_block(DATA, event);
+	log.lba = logicalBlockAddress;
+	log.lastWrite = sequential_clock++;
+}
+
+void FtlImpl_Fast::switch_sequential(Event &event, SequentialLog &log)
 {
 	// Add to empty list i.e. switch without erasing the datablock.
 
-	if (data_list[sequential_logicalblock_address] != -1)
-		Block_manager::instance()->invalidate(Address(data_list[sequential_logicalblock_address], BLOCK), DATA);
+	if (data_list[log.lba] != -1)
+		Block_manager::instance()->invalidate(Address(data_list[log.lba], BLOCK), DATA);
 
-	data_list[sequential_logicalblock_address] = sequential_address.get_linear_address();
+	data_list[log.lba] = log.address.get_linear_address();
 
 	update_map_block(event);
 
 	controller.stats.numLogMergeSwitch++;
 }
 
-void FtlImpl_Fast::merge_sequential(Event &event)
+void FtlImpl_Fast::merge_sequential(Event &event, SequentialLog &log)
 {
-	if (sequential_logicalblock_address == -1)
+	if (log.lba == -1)
 		return;
 
 	// Do merge (n reads, n writes and 2 erases (gc'ed))
@@ -298,21 +324,23 @@ void FtlImpl_Fast::merge_sequential(Event &event)
 		// Lookup page table and see if page exist in log page
 		Address readAddress;
 
-		Address seq = Address(sequential_address.get_linear_address() + i, PAGE);
+		Address seq = Address(log.address.get_linear_address() + i, PAGE);
 		if (get_state(seq) == VALID)
 			readAddress = seq;
-		else if (data_list[sequential_logicalblock_address] != -1 && get_state(Address(data_list[sequential_logicalblock_address] + i, PAGE)) == VALID)
-			readAddress.set_linear_address(data_list[sequential_logicalblock_address] + i, PAGE);
+		else if (data_list[log.lba] != -1 && get_state(Address(data_list[log.lba] + i, PAGE)) == VALID)
+			readAddress.set_linear_address(data_list[log.lba] + i, PAGE);
 		else
 			continue; // Empty page
 
 		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
 		readEvent.set_address(readAddress);
+		readEvent.set_cause(CAUSE_MERGE);
 		if (controller.issue(readEvent) == FAILURE) { printf("Read failed\n"); return; }
 
 		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
 		writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
 		writeEvent.set_address(Address(newDataBlock.get_linear_address() + i, PAGE));
+		writeEvent.set_cause(CAUSE_MERGE);
 		if (controller.issue(writeEvent) == FAILURE) {  printf("Write failed\n"); return; }
 
 		event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
@@ -325,12 +353,12 @@ void FtlImpl_Fast::merge_sequential(Event &event)
 	}
 
 	// Invalidate inactive pages
-	Block_manager::instance()->invalidate(&sequential_address, DATA);
-	if (data_list[sequential_logicalblock_address] != -1)
-		Block_manager::instance()->invalidate(Address(data_list[sequential_logicalblock_address], BLOCK), DATA);
+	Block_manager::instance()->invalidate(&log.address, DATA);
+	if (data_list[log.lba] != -1)
+		Block_manager::instance()->invalidate(Address(data_list[log.lba], BLOCK), DATA);
 
 	// Update mapping
-	data_list[sequential_logicalblock_address] = newDataBlock.get_linear_address();
+	data_list[log.lba] = newDataBlock.get_linear_address();
 
 	controller.stats.numLogMergeFull++;
 
@@ -353,6 +381,11 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 
 	bool pinned[BLOCK_SIZE];
 
+	// The log blocks, oldest first
+	std::vector<LogPageBlock*> logBlocks;
+	for (LogPageBlock *lpb = log_pages; lpb != NULL; lpb = lpb->next)
+		logBlocks.push_back(lpb);
+
 	typedef std::map<long, bool>::const_iterator CI;
 
 	// Go though all the required merges
@@ -372,9 +405,7 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 		// Find the last block and then the next last etc.
 		for (int logblockNr = FAST_LOG_BLOCK_LIMIT; logblockNr > 0; logblockNr--)
 		{
-			LogPageBlock *lpb = log_pages;
-			for (int i = 0;i<logblockNr-1;i++)
-				lpb = lpb->next;
+			LogPageBlock *lpb = logBlocks[logblockNr-1];
 
 			// Go though the pages and see if any falls into the same category as the current logical block
 			for (int i=lpb->numPages-1;i>0;i--)
@@ -399,6 +430,7 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 						Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
 						Address readAddress = Address(lpb->address.get_linear_address()+i, PAGE);
 						readEvent.set_address(readAddress);
+						readEvent.set_cause(CAUSE_MERGE);
 
 						if (controller.issue(readEvent) == FAILURE) { printf("failed\n"); return false; }
 						//event.consolidate_metaevent(readEvent);
@@ -406,6 +438,7 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 						Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
 						writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
 						writeEvent.set_address(writeAddress);
+						writeEvent.set_cause(CAUSE_MERGE);
 
 						if (controller.issue(writeEvent) == FAILURE) { printf("failed\n"); return false; }
 						//event.consolidate_metaevent(writeEvent);
@@ -436,6 +469,7 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 				{
 					Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
 					readEvent.set_address(readAddress);
+					readEvent.set_cause(CAUSE_MERGE);
 					if (controller.issue(readEvent) == FAILURE) { printf("failed\n"); return false;	}
 					//event.consolidate_metaevent(readEvent);
 
@@ -443,6 +477,7 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 					Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
 					writeEvent.set_payload((char*)page_data + readAddress.get_linear_address() * PAGE_SIZE);
 					writeEvent.set_address(writeAddress);
+					writeEvent.set_cause(CAUSE_MERGE);
 					if (controller.issue(writeEvent) == FAILURE) { printf("failed\n"); return false;	}
 					//event.consolidate_metaevent(writeEvent);
 
@@ -476,21 +511,32 @@ bool FtlImpl_Fast::random_merge(LogPageBlock *logBlock, Event &event)
 bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 {
 	uint lbnOffset = event.get_logical_address() % BLOCK_SIZE;
+	int seq = find_sequential(logicalBlockAddress);
+
 	if (lbnOffset == 0) /* Case 1 in Figure 5 */
 	{
-		if (sequential_offset == BLOCK_SIZE)
+		if (seq == -1)
+			seq = select_sequential(logicalBlockAddress);
+
+		SequentialLog &log = sequential_logs[seq];
+
+		if (log.offset == BLOCK_SIZE)
 		{
 			/* The log block is filled with sequentially written sectors
 			 * Perform switch operation
 			 * After switch, the data block is erased and returned to the free-block list
 			 */
-			switch_sequential(event);
+			controller.stats.latency_begin(LATENCY_MERGE, event);
+			switch_sequential(event, log);
+			controller.stats.latency_end(event);
 		} else {
 			/* Before merge, a new block is allocated from the free-block list
 			 * merge the SW log block with its corresponding data block
 			 * after merge, the two blocks are erased and returned to the free-block list
 			 */
-			merge_sequential(event);
+			controller.stats.latency_begin(LATENCY_MERGE, event);
+			merge_sequential(event, log);
+			controller.stats.latency_end(event);
 		}
 
 		/* Get a block from the free-block list and use it as a SW log block
@@ -498,36 +544,37 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 		 * Update the SW log block part of the sector mapping table
 		 */
 
-		sequential_offset = 1;
-		sequential_address = Block_manager::instance()->get_free_block(DATA, event);
-		sequential_logicalblock_address = logicalBlockAddress;
+		open_sequential(event, log, logicalBlockAddress);
 
-		event.set_address(sequential_address);
+		event.set_address(log.address);
 	} else {
-		if (sequential_logicalblock_address == logicalBlockAddress) // If the current owner for the SW log block is the same with lbn
+		if (seq != -1) // If the current owner for the SW log block is the same with lbn
 		{
+			SequentialLog &log = sequential_logs[seq];
+
 			// last_lsn = getLastLsnFromSMT(lbn) Sector mapping table
 
-			if (lbnOffset == sequential_offset)// lsn is equivalent with (last_lsn+1)
+			if (lbnOffset == log.offset)// lsn is equivalent with (last_lsn+1)
 			{
 				// Append data to the SW log block
-				Address seq = sequential_address;
-				controller.get_free_page(seq);
-				event.set_address(seq);
+				Address seqAddress = log.address;
+				controller.get_free_page(seqAddress);
+				event.set_address(seqAddress);
 
-				sequential_offset++;
+				log.offset++;
+				log.lastWrite = sequential_clock++;
 
 			} else {
 				// Merge the SW log block with its corresponding data block
 				// Get a block from the free-block list and use it as a SW log block
-				merge_sequential(event);
+				controller.stats.latency_begin(LATENCY_MERGE, event);
+				merge_sequential(event, log);
+				controller.stats.latency_end(event);
 
-				sequential_offset = 1;
-				sequential_address = Block_manager::instance()->get_free_block(DATA, event);
-				sequential_logicalblock_address = logicalBlockAddress;
+				open_sequential(event, log, logicalBlockAddress);
 
 				// Append data to the SW log block
-				event.set_address(sequential_address);
+				event.set_address(log.address);
 			}
 			// Update the SW log block part of the sector mapping table
 		} else {
@@ -542,9 +589,12 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 
 				LogPageBlock *victim = log_pages;
 
+				controller.stats.latency_begin(LATENCY_MERGE, event);
 				random_merge(victim, event);
+				controller.stats.latency_end(event);
 
 				// Maintain the log page list
+				drop_log_index(victim);
 				log_pages = log_pages->next;
 				Block_manager::instance()->invalidate(&victim->address, LOG);
 				delete victim;
@@ -569,6 +619,9 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 			victim->aPages[log_page_next % BLOCK_SIZE] = event.get_logical_address();
 			victim->numPages++;
 
+			log_index[event.get_logical_address()].block = victim;
+			log_index[event.get_logical_address()].offset = log_page_next % BLOCK_SIZE;
+
 			Address rw = victim->address;
 			rw.valid = PAGE;
 			rw += log_page_next % BLOCK_SIZE;
@@ -581,11 +634,26 @@ bool FtlImpl_Fast::write_to_log_block(Event &event, long logicalBlockAddress)
 	return true;
 }
 
+/*
+ * Forgets the pages of a log block leaving the log. Copies that were
+ * superseded by a later log write are indexed elsewhere and stay.
+ */
+void FtlImpl_Fast::drop_log_index(LogPageBlock *logBlock)
+{
+	for (int i=0;i<logBlock->numPages;i++)
+	{
+		long lpn = logBlock->aPages[i];
+		if (lpn != -1 && log_index[lpn].block == logBlock)
+			log_index[lpn].block = NULL;
+	}
+}
+
 void FtlImpl_Fast::update_map_block(Event &event)
 {
 	Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time());
 	writeEvent.set_address(Address(0, PAGE));
 	writeEvent.set_noop(true);
+	writeEvent.set_cause(CAUSE_MAPPING);
 
 	controller.issue(writeEvent);
 
@@ -0,0 +1,462 @@
+/* learned_ftl.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Learned-index FTL in the style of the paper
+ * "LeaFTL: A Learning-Based Flash Translation Layer for Solid-State Drives"
+ *
+ * The page-level map is kept on flash in translation pages, located through
+ * the GTD, exactly as in DFTL.  What the controller caches is not mapping
+ * entries but segments: for each resident translation page, the mapped
+ * logical pages are covered by line segments that predict their physical
+ * page to within LEARNED_ERROR_BOUND pages.  Segments are fitted greedily,
+ * narrowing the range of slopes that keeps every point within the bound
+ * until a point falls outside it.
+ *
+ * Resident translation pages are evicted in LRU order once their segments
+ * exceed LEARNED_CACHE_LIMIT pages of RAM, written back first if updated.
+ * Updates only mark the segments stale; they are fitted again on the next
+ * lookup.  A misprediction is detected through the OOB area of the page
+ * read, which holds the logical page numbers of its neighbours, and costs
+ * one more read of the right page.
+ *
+ * GC copies the valid pages of a victim block in logical order, so they
+ * form sequential runs that fit into few segments again.
+ */
+
+#include <new>
+#include <assert.h>
+#include <stdio.h>
+#include <math.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+FtlImpl_Learned::FtlImpl_Learned(Controller &controller):
+	FtlImpl_DftlParent(controller),
+	group_lru_head(-1),
+	group_lru_tail(-1),
+	ramUsed(0),
+	numSegments(0),
+	numLookups(0),
+	numMispredictions(0),
+	numLearned(0)
+{
+	SegmentGroup empty;
+	empty.loaded = false;
+	empty.stale = false;
+	empty.dirty = false;
+	empty.prev = -1;
+	empty.next = -1;
+	groups.assign(numTranslationPages, empty);
+
+	ramLimit = (long) LEARNED_CACHE_LIMIT * PAGE_SIZE;
+
+	printf("Learned FTL segment memory: %li bytes, error bound: %u pages\n", ramLimit, LEARNED_ERROR_BOUND);
+	printf("Using Learned FTL.\n");
+}
+
+FtlImpl_Learned::~FtlImpl_Learned(void)
+{
+	return;
+}
+
+enum status FtlImpl_Learned::read(Event &event)
+{
+	long dlpn = event.get_logical_address();
+
+	load_group(event, dlpn / addressPerPage);
+
+	long ppn = trans_map[dlpn];
+	if (ppn == -1)
+	{
+		event.set_address(Address(0, PAGE));
+		event.set_noop(true);
+	}
+	else
+	{
+		long guess = predict(event, dlpn);
+
+		numLookups++;
+		if (guess != ppn)
+		{
+			controller.stats.latency_begin(LATENCY_MAPPING, event);
+
+			// The OOB area of the predicted page points to the right one.
+			Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+			readEvent.set_address(Address(guess, PAGE));
+			readEvent.set_cause(CAUSE_MAPPING);
+
+			if (controller.issue(readEvent) == FAILURE) { assert(false);}
+
+			event.incr_time_taken(readEvent.get_time_taken());
+			controller.stats.numFTLRead++;
+			numMispredictions++;
+
+			controller.stats.latency_end(event);
+		}
+
+		event.set_address(Address(ppn, PAGE));
+	}
+
+	update_memory();
+	controller.stats.numFTLRead++;
+
+	return controller.issue(event);
+}
+
+enum status FtlImpl_Learned::write(Event &event)
+{
+	long dlpn = event.get_logical_address();
+
+	load_group(event, dlpn / addressPerPage);
+
+	// Important order. As get_free_data_page might change current.
+	long free_page = get_free_data_page(event);
+
+	long ppn = trans_map[dlpn];
+	if (ppn != -1)
+		event.set_replace_address(Address(ppn, PAGE));
+
+	update_translation_map(dlpn, free_page);
+	mark_updated(dlpn);
+
+	event.set_address(Address(free_page, PAGE));
+
+	update_memory();
+	controller.stats.numFTLWrite++;
+
+	return controller.issue(event);
+}
+
+enum status FtlImpl_Learned::trim(Event &event)
+{
+	long dlpn = event.get_logical_address();
+
+	event.set_address(Address(0, PAGE));
+
+	long ppn = trans_map[dlpn];
+	if (ppn != -1)
+	{
+		load_group(event, dlpn / addressPerPage);
+
+		Address address = Address(ppn, PAGE);
+		Block *block = controller.get_block_pointer(address);
+		block->invalidate_page(address.page);
+
+		update_translation_map(dlpn, -1);
+		mark_updated(dlpn);
+	}
+
+	update_memory();
+	controller.stats.numFTLTrim++;
+
+	return controller.issue(event);
+}
+
+void FtlImpl_Learned::cleanup_block(Event &event, Block *block)
+{
+	if (block->get_block_type() == MAP)
+	{
+		cleanup_translation_block(event, block);
+		return;
+	}
+
+	// Valid pages as (logical, physical) page pairs, in logical order
+	std::vector<std::pair<long, long> > valid;
+
+	for (uint i=0;i<BLOCK_SIZE;i++)
+	{
+		assert(block->get_state(i) != EMPTY);
+
+		if (block->get_state(i) == VALID)
+		{
+			long ppn = block->get_physical_address()+i;
+			valid.push_back(std::make_pair(reverse_trans_map[ppn], ppn));
+		}
+	}
+
+	std::sort(valid.begin(), valid.end());
+
+	std::vector<long> updated;
+
+	for (uint i=0;i<valid.size();i++)
+	{
+		long dlpn = valid[i].first;
+		long ppn = valid[i].second;
+
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+		readEvent.set_address(Address(ppn, PAGE));
+		readEvent.set_cause(CAUSE_GC);
+
+		if (controller.issue(readEvent) == FAILURE)
+			printf("Data block copy failed.");
+
+		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
+		long free_page = get_free_data_page(event, false);
+		writeEvent.set_address(Address(free_page, PAGE));
+		writeEvent.set_replace_address(Address(ppn, PAGE));
+		writeEvent.set_payload((char*)page_data + ppn * PAGE_SIZE);
+		writeEvent.set_cause(CAUSE_GC);
+
+		if (controller.issue(writeEvent) == FAILURE)
+			printf("Data block copy failed.");
+
+		event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+
+		update_translation_map(dlpn, free_page);
+
+		long mlpn = dlpn / addressPerPage;
+		if (updated.empty() || updated.back() != mlpn)
+			updated.push_back(mlpn);
+
+		controller.stats.numFTLRead++;
+		controller.stats.numFTLWrite++;
+		controller.stats.numGCRead++;
+		controller.stats.numGCWrite++;
+	}
+
+	/*
+	 * Resident translation pages are relearned on their next lookup and
+	 * written back on eviction; the others are written back now, once each.
+	 */
+	for (uint i=0;i<updated.size();i++)
+	{
+		SegmentGroup &group = groups[updated[i]];
+
+		if (group.loaded)
+		{
+			group.stale = true;
+			group.dirty = true;
+		}
+		else
+			write_translation_page(event, updated[i]);
+	}
+}
+
+/* Make a translation page resident, reading it from flash if it is not */
+void FtlImpl_Learned::load_group(Event &event, long mlpn)
+{
+	SegmentGroup &group = groups[mlpn];
+
+	event.incr_time_taken(RAM_READ_DELAY);
+	controller.stats.numMemoryRead++;
+
+	if (group.loaded)
+	{
+		controller.stats.numCacheHits++;
+		group_unlink(mlpn);
+		group_link(mlpn);
+		return;
+	}
+
+	controller.stats.numCacheFaults++;
+
+	consult_GTD(mlpn * addressPerPage, event);
+
+	group.loaded = true;
+	group.dirty = false;
+	group_link(mlpn);
+
+	learn_group(mlpn);
+	evict_groups(event, mlpn);
+}
+
+/* Evict least recently used translation pages until the segments fit in
+ * RAM again, but never the one given */
+void FtlImpl_Learned::evict_groups(Event &event, long keep)
+{
+	if (ramUsed <= ramLimit)
+		return;
+
+	controller.stats.latency_begin(LATENCY_MAPPING, event);
+
+	while (ramUsed > ramLimit && group_lru_head != -1 && group_lru_head != keep)
+	{
+		long mlpn = group_lru_head;
+		SegmentGroup &group = groups[mlpn];
+
+		if (group.dirty)
+			write_translation_page(event, mlpn);
+
+		ramUsed -= group.segments.size() * LEARNED_SEGMENT_BYTES;
+		numSegments -= group.segments.size();
+		std::vector<Segment>().swap(group.segments);
+
+		group.loaded = false;
+		group.stale = false;
+		group.dirty = false;
+		group_unlink(mlpn);
+	}
+
+	controller.stats.latency_end(event);
+}
+
+/* Fit the mappings of a translation page with as few segments as the
+ * error bound allows */
+void FtlImpl_Learned::learn_group(long mlpn)
+{
+	SegmentGroup &group = groups[mlpn];
+	double bound = LEARNED_ERROR_BOUND;
+	double lo = 0.0, hi = 0.0;
+	Segment seg = {-1, -1, 0.0, 0};
+
+	ramUsed -= group.segments.size() * LEARNED_SEGMENT_BYTES;
+	numSegments -= group.segments.size();
+	group.segments.clear();
+
+	long first = mlpn * addressPerPage;
+	long last = std::min(first + addressPerPage, (long) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE);
+
+	for (long dlpn = first; dlpn < last; dlpn++)
+	{
+		long ppn = trans_map[dlpn];
+		if (ppn == -1)
+			continue;
+
+		if (seg.length > 0)
+		{
+			double dx = dlpn - seg.lpn;
+			double nlo = std::max(lo, (ppn - bound - seg.ppn) / dx);
+			double nhi = std::min(hi, (ppn + bound - seg.ppn) / dx);
+
+			if (nlo <= nhi)
+			{
+				lo = nlo;
+				hi = nhi;
+				seg.length = dlpn - seg.lpn + 1;
+				continue;
+			}
+
+			seg.slope = (seg.length > 1) ? (lo + hi) / 2 : 0.0;
+			group.segments.push_back(seg);
+		}
+
+		seg.lpn = dlpn;
+		seg.ppn = ppn;
+		seg.length = 1;
+		lo = -std::numeric_limits<double>::infinity();
+		hi = std::numeric_limits<double>::infinity();
+	}
+
+	if (seg.length > 0)
+	{
+		seg.slope = (seg.length > 1) ? (lo + hi) / 2 : 0.0;
+		group.segments.push_back(seg);
+	}
+
+	ramUsed += group.segments.size() * LEARNED_SEGMENT_BYTES;
+	numSegments += group.segments.size();
+	group.stale = false;
+	numLearned++;
+}
+
+/* Physical page the segments predict for a mapped logical page */
+long FtlImpl_Learned::predict(Event &event, long dlpn)
+{
+	long mlpn = dlpn / addressPerPage;
+	SegmentGroup &group = groups[mlpn];
+
+	if (group.stale)
+	{
+		learn_group(mlpn);
+		evict_groups(event, mlpn);
+	}
+
+	event.incr_time_taken(RAM_READ_DELAY);
+	controller.stats.numMemoryRead++;
+
+	// Last segment starting at or before the page
+	uint lo = 0, hi = group.segments.size();
+	while (lo < hi)
+	{
+		uint mid = (lo + hi) / 2;
+		if (group.segments[mid].lpn <= dlpn)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	assert(lo > 0);
+	const Segment &seg = group.segments[lo - 1];
+	assert(dlpn < seg.lpn + (long) seg.length);
+
+	long guess = seg.ppn + lround(seg.slope * (dlpn - seg.lpn));
+	long maxPage = (long) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE - 1;
+
+	return std::max(0L, std::min(guess, maxPage));
+}
+
+void FtlImpl_Learned::mark_updated(long dlpn)
+{
+	SegmentGroup &group = groups[dlpn / addressPerPage];
+
+	group.stale = true;
+	group.dirty = true;
+
+	controller.stats.numMemoryWrite++;
+}
+
+/* RAM holding the segments and the GTD */
+void FtlImpl_Learned::update_memory()
+{
+	controller.stats.numMemoryTranslation = ramUsed + numTranslationPages * entryBytes;
+}
+
+void FtlImpl_Learned::group_link(long mlpn)
+{
+	SegmentGroup &group = groups[mlpn];
+
+	group.prev = group_lru_tail;
+	group.next = -1;
+	if (group_lru_tail != -1)
+		groups[group_lru_tail].next = mlpn;
+	else
+		group_lru_head = mlpn;
+	group_lru_tail = mlpn;
+}
+
+void FtlImpl_Learned::group_unlink(long mlpn)
+{
+	SegmentGroup &group = groups[mlpn];
+
+	if (group.prev != -1)
+		groups[group.prev].next = group.next;
+	else
+		group_lru_head = group.next;
+	if (group.next != -1)
+		groups[group.next].prev = group.prev;
+	else
+		group_lru_tail = group.prev;
+}
+
+/* resident segments */
+long FtlImpl_Learned::get_num_cached_mappings() const
+{
+	return numSegments;
+}
+
+void FtlImpl_Learned::print_ftl_statistics()
+{
+	printf("Learned FTL:\n");
+	printf("Segments: %li (%li of %li bytes)\n", numSegments, ramUsed, ramLimit);
+	printf("Lookups: %lu Mispredictions: %lu (%f)\n", numLookups, numMispredictions,
+			numLookups > 0 ? (double) numMispredictions / numLookups : 0.0);
+	printf("Segment fits: %lu\n", numLearned);
+	Block_manager::instance()->print_statistics();
+}
@@ -17,36 +17,83 @@
 
 /****************************************************************************/
 
-/* Implements a very simple page-level FTL without merge */
+/* Implements a page-level FTL
+ *
+ * The whole logical to physical map is held in RAM, with its reverse to
+ * find the owner of a physical page during GC.  Every die has its own write
+ * point; consecutive writes go to consecutive packages first, then to the
+ * next die of each package, so a stream of writes is spread over all
+ * channels.  GC copies live pages into a separate write point of the die,
+ * keeping them apart from fresh host data.
+ *
+ * Free blocks and greedy GC are per die, in the Block_manager (see
+ * collect_die).  With no mapping traffic at all this is the upper bound
+ * for the hybrid and cached FTLs.
+ *
+ * PAGE_SPARE_BLOCKS blocks of every die stay out of the logical space: the
+ * write points and GC need free blocks when the exported capacity is full,
+ * else a full-device overwrite finds no victim with invalid pages.  Requests
+ * beyond the smaller capacity fail instead of running the device dry.
+ */
 
 #include <new>
 #include <assert.h>
 #include <stdio.h>
-#include <math.h>
+#include <stdlib.h>
 #include "ssd.h"
 
 using namespace ssd;
 
 FtlImpl_Page::FtlImpl_Page(Controller &controller):
-	FtlParent(controller)
+	FtlParent(controller),
+	write_points(SSD_SIZE * PACKAGE_SIZE, -1),
+	gc_points(SSD_SIZE * PACKAGE_SIZE, -1),
+	currentDie(0)
 {
-	trim_map = new bool[NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE];
+	ulong ssdSize = (ulong) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE;
+	ulong dies = (ulong) SSD_SIZE * PACKAGE_SIZE;
+	uint spare = PAGE_SPARE_BLOCKS < 3 ? 3 : PAGE_SPARE_BLOCKS;
 
-	numPagesActive = 0;
+	if ((ulong) DIE_SIZE * PLANE_SIZE <= spare)
+	{
+		fprintf(stderr, "Page FTL error: %s: %u blocks per die leave no room beyond %u spare blocks\n", __func__, DIE_SIZE * PLANE_SIZE, spare);
+		exit(MEM_ERR);
+	}
+
+	logicalPages = ssdSize - dies * spare * BLOCK_SIZE;
 
+	map = new long[logicalPages];
+	reverse_map = new long[ssdSize];
+	for (ulong i = 0; i < logicalPages; i++)
+		map[i] = -1;
+	for (ulong i = 0; i < ssdSize; i++)
+		reverse_map[i] = -1;
+
+	printf("Using page-mapped FTL, %lu logical pages and %u spare blocks per die.\n", logicalPages, spare);
 	return;
 }
 
 FtlImpl_Page::~FtlImpl_Page(void)
 {
-
+	delete[] map;
+	delete[] reverse_map;
 	return;
 }
 
 enum status FtlImpl_Page::read(Event &event)
 {
-	event.set_address(Address(0, PAGE));
-	event.set_noop(true);
+	if (!in_range(event, __func__))
+		return FAILURE;
+
+	long ppn = map[event.get_logical_address()];
+
+	if (ppn == -1)
+	{
+		event.set_address(Address(0, PAGE));
+		event.set_noop(true);
+	}
+	else
+		event.set_address(Address(ppn, PAGE));
 
 	controller.stats.numFTLRead++;
 
@@ -55,65 +102,143 @@ enum status FtlImpl_Page::read(Event &event)
 
 enum status FtlImpl_Page::write(Event &event)
 {
-	event.set_address(Address(1, PAGE));
-	event.set_noop(true);
-
-	controller.stats.numFTLWrite++;
+	if (!in_range(event, __func__))
+		return FAILURE;
 
-	if (numPagesActive == NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE)
-	{
-		numPagesActive -= BLOCK_SIZE;
-
-		Event eraseEvent = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
-		eraseEvent.set_address(Address(0, PAGE));
-
-		if (controller.issue(eraseEvent) == FAILURE) printf("Erase failed");
+	long lpn = event.get_logical_address();
 
-		event.incr_time_taken(eraseEvent.get_time_taken());
+	// Important order. GC behind get_free_page may move the old copy.
+	long ppn = get_free_page(event, next_die(), false);
 
-		controller.stats.numFTLErase++;
+	if (map[lpn] != -1)
+	{
+		event.set_replace_address(Address(map[lpn], PAGE));
+		reverse_map[map[lpn]] = -1;
 	}
 
-	numPagesActive++;
+	map[lpn] = ppn;
+	reverse_map[ppn] = lpn;
+
+	event.set_address(Address(ppn, PAGE));
 
+	controller.stats.numFTLWrite++;
 
 	return controller.issue(event);
 }
 
 enum status FtlImpl_Page::trim(Event &event)
 {
-	controller.stats.numFTLTrim++;
+	if (!in_range(event, __func__))
+		return FAILURE;
 
-	uint dlpn = event.get_logical_address();
+	long lpn = event.get_logical_address();
+	long ppn = map[lpn];
 
-	if (!trim_map[event.get_logical_address()])
-		trim_map[event.get_logical_address()] = true;
+	event.set_address(Address(0, PAGE));
 
-	// Update trim map and update block map if all pages are trimmed. i.e. the state are reseted to optimal.
-	long addressStart = dlpn - dlpn % BLOCK_SIZE;
-	bool allTrimmed = true;
-	for (uint i=addressStart;i<addressStart+BLOCK_SIZE;i++)
+	if (ppn != -1)
 	{
-		if (!trim_map[i])
-			allTrimmed = false;
+		Address address = Address(ppn, PAGE);
+		controller.get_block_pointer(address)->invalidate_page(address.page);
+
+		map[lpn] = -1;
+		reverse_map[ppn] = -1;
 	}
 
-	if (allTrimmed)
+	controller.stats.numFTLTrim++;
+
+	return controller.issue(event);
+}
+
+/*
+ * Copies the valid pages of a GC victim to the GC write point of its die.
+ * The Block_manager erases the block afterwards.
+ */
+void FtlImpl_Page::cleanup_block(Event &event, Block *block)
+{
+	uint die = block->get_physical_address() / ((ulong) DIE_SIZE * PLANE_SIZE * BLOCK_SIZE);
+
+	for (uint i = 0; i < BLOCK_SIZE; i++)
 	{
-		Event eraseEvent = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
-		eraseEvent.set_address(Address(0, PAGE));
+		if (block->get_state(i) != VALID)
+			continue;
+
+		long oldPpn = block->get_physical_address() + i;
+		long lpn = reverse_map[oldPpn];
+		assert(lpn != -1);
+
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+		readEvent.set_address(Address(oldPpn, PAGE));
+		readEvent.set_cause(CAUSE_GC);
 
-		if (controller.issue(eraseEvent) == FAILURE) printf("Erase failed");
+		if (controller.issue(readEvent) == FAILURE)
+			printf("Data block copy failed.");
 
-		event.incr_time_taken(eraseEvent.get_time_taken());
+		long ppn = get_free_page(event, die, true);
 
-		for (uint i=addressStart;i<addressStart+BLOCK_SIZE;i++)
-			trim_map[i] = false;
+		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time() + readEvent.get_time_taken());
+		writeEvent.set_address(Address(ppn, PAGE));
+		writeEvent.set_replace_address(Address(oldPpn, PAGE));
+		writeEvent.set_cause(CAUSE_GC);
+		writeEvent.set_payload((char*)page_data + oldPpn * PAGE_SIZE);
 
-		controller.stats.numFTLErase++;
+		if (controller.issue(writeEvent) == FAILURE)
+			printf("Data block copy failed.");
 
-		numPagesActive -= BLOCK_SIZE;
+		event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+
+		map[lpn] = ppn;
+		reverse_map[ppn] = lpn;
+		reverse_map[oldPpn] = -1;
+
+		controller.stats.numGCRead++;
+		controller.stats.numGCWrite++;
 	}
+}
+
+/*
+ * Next page of the host (or GC) write point of the die, starting a new
+ * block when the current one is full.
+ */
+long FtlImpl_Page::get_free_page(Event &event, uint die, bool gc)
+{
+	long &point = gc ? gc_points[die] : write_points[die];
+
+	if (point == -1 || point % BLOCK_SIZE == BLOCK_SIZE - 1)
+		point = Block_manager::instance()->get_free_block(DATA, event, die).get_linear_address();
+	else
+		point++;
+
+	return point;
+}
+
+/*
+ * Dies in write order: package 0 to SSD_SIZE - 1 on the first die of every
+ * package, then the same on the second die and so on.
+ */
+uint FtlImpl_Page::next_die()
+{
+	uint package = currentDie % SSD_SIZE;
+	uint die = (currentDie / SSD_SIZE) % PACKAGE_SIZE;
+
+	currentDie = (currentDie + 1) % (SSD_SIZE * PACKAGE_SIZE);
+
+	return package * PACKAGE_SIZE + die;
+}
+
+ulong FtlImpl_Page::get_logical_pages() const
+{
+	return logicalPages;
+}
+
+/*
+ * Logical pages past the exported capacity would eat into the spare blocks.
+ */
+bool FtlImpl_Page::in_range(Event &event, const char *func)
+{
+	if (event.get_logical_address() < logicalPages)
+		return true;
 
-	return SUCCESS;
+	fprintf(stderr, "Page FTL error: %s: logical page %lu beyond the %lu exported\n", func, event.get_logical_address(), logicalPages);
+	return false;
 }
@@ -0,0 +1,217 @@
+/* tpftl_ftl.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Implementation of the TPFTL described in the paper
+ * "TPFTL: A Translation Page-level Aware FTL for Flash Memory"
+ *
+ * Reads, writes, trims and GC are those of DFTL; only the CMT differs.
+ * Cached entries are kept in translation page (TP) nodes.  Entries are in
+ * LRU order inside their node and nodes in LRU order among themselves, a
+ * node moving up whenever one of its entries is referenced.  The victim is
+ * the least recently used entry of the least recently used node.
+ *
+ * Request-level prefetching: a miss reads the translation page anyway, so
+ * the mappings of the remaining pages of the same request that it holds
+ * are loaded along with the one asked for.
+ *
+ * Batch update: evicting a dirty entry writes back its translation page,
+ * which cleans every other dirty entry of the node too (see evict_entry).
+ */
+
+#include <new>
+#include <assert.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+FtlImpl_Tpftl::FtlImpl_Tpftl(Controller &controller):
+	FtlImpl_Dftl(controller),
+	tp_lru_head(-1),
+	tp_lru_tail(-1),
+	numPrefetched(0)
+{
+	TpNode empty = {-1, -1, 0, -1, -1};
+	tp_nodes.assign(numTranslationPages, empty);
+
+	printf("Using TPFTL.\n");
+	return;
+}
+
+FtlImpl_Tpftl::~FtlImpl_Tpftl(void)
+{
+	return;
+}
+
+void FtlImpl_Tpftl::resolve_mapping(Event &event, bool isWrite)
+{
+	long dlpn = event.get_logical_address();
+	bool miss = cmt_find(dlpn) == -1;
+
+	FtlImpl_DftlParent::resolve_mapping(event, isWrite);
+
+	if (!miss)
+		return;
+
+	// Prefetch the rest of the request, up to the end of the translation page
+	long last = dlpn + event.get_request_pages() - 1;
+	long pageEnd = dlpn - dlpn % addressPerPage + addressPerPage - 1;
+	long mapEnd = (long) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE - 1;
+
+	if (last > pageEnd)
+		last = pageEnd;
+	if (last > mapEnd)
+		last = mapEnd;
+
+	for (long vpn = dlpn + 1; vpn <= last; vpn++)
+	{
+		if (cmt_find(vpn) != -1)
+			continue;
+
+		evict_page_from_cache(event);
+		cmt_insert(vpn, false, true);
+
+		event.incr_time_taken(RAM_WRITE_DELAY);
+		controller.stats.numMemoryWrite++;
+		numPrefetched++;
+	}
+}
+
+/* Entries join their node at the most recently used end when hot, at the
+ * least recently used end otherwise; a node becoming non-empty is linked
+ * the same way */
+void FtlImpl_Tpftl::cmt_link(long index, bool hot)
+{
+	CmtEntry &entry = cmt_entries[index];
+	long mlpn = entry.vpn / addressPerPage;
+	TpNode &node = tp_nodes[mlpn];
+
+	if (node.count == 0)
+		tp_link(mlpn, hot);
+	else if (hot)
+	{
+		tp_unlink(mlpn);
+		tp_link(mlpn, true);
+	}
+
+	if (hot)
+	{
+		entry.lru_prev = node.tail;
+		entry.lru_next = -1;
+		if (node.tail != -1)
+			cmt_entries[node.tail].lru_next = index;
+		else
+			node.head = index;
+		node.tail = index;
+	}
+	else
+	{
+		entry.lru_prev = -1;
+		entry.lru_next = node.head;
+		if (node.head != -1)
+			cmt_entries[node.head].lru_prev = index;
+		else
+			node.tail = index;
+		node.head = index;
+	}
+
+	node.count++;
+}
+
+void FtlImpl_Tpftl::cmt_unlink(long index)
+{
+	CmtEntry &entry = cmt_entries[index];
+	long mlpn = entry.vpn / addressPerPage;
+	TpNode &node = tp_nodes[mlpn];
+
+	if (entry.lru_prev != -1)
+		cmt_entries[entry.lru_prev].lru_next = entry.lru_next;
+	else
+		node.head = entry.lru_next;
+	if (entry.lru_next != -1)
+		cmt_entries[entry.lru_next].lru_prev = entry.lru_prev;
+	else
+		node.tail = entry.lru_prev;
+
+	node.count--;
+
+	if (node.count == 0)
+		tp_unlink(mlpn);
+}
+
+void FtlImpl_Tpftl::cmt_touch(long index)
+{
+	long mlpn = cmt_entries[index].vpn / addressPerPage;
+
+	if (index == tp_nodes[mlpn].tail && mlpn == tp_lru_tail)
+		return;
+
+	cmt_unlink(index);
+	cmt_link(index, true);
+}
+
+long FtlImpl_Tpftl::cmt_victim()
+{
+	assert(tp_lru_head != -1);
+	return tp_nodes[tp_lru_head].head;
+}
+
+void FtlImpl_Tpftl::tp_link(long mlpn, bool hot)
+{
+	TpNode &node = tp_nodes[mlpn];
+
+	if (hot)
+	{
+		node.prev = tp_lru_tail;
+		node.next = -1;
+		if (tp_lru_tail != -1)
+			tp_nodes[tp_lru_tail].next = mlpn;
+		else
+			tp_lru_head = mlpn;
+		tp_lru_tail = mlpn;
+	}
+	else
+	{
+		node.prev = -1;
+		node.next = tp_lru_head;
+		if (tp_lru_head != -1)
+			tp_nodes[tp_lru_head].prev = mlpn;
+		else
+			tp_lru_tail = mlpn;
+		tp_lru_head = mlpn;
+	}
+}
+
+void FtlImpl_Tpftl::tp_unlink(long mlpn)
+{
+	TpNode &node = tp_nodes[mlpn];
+
+	if (node.prev != -1)
+		tp_nodes[node.prev].next = node.next;
+	else
+		tp_lru_head = node.next;
+	if (node.next != -1)
+		tp_nodes[node.next].prev = node.prev;
+	else
+		tp_lru_tail = node.prev;
+}
+
+void FtlImpl_Tpftl::print_ftl_statistics()
+{
+	printf("Prefetched mappings: %lu\n", numPrefetched);
+	FtlImpl_Dftl::print_ftl_statistics();
+}
@@ -0,0 +1,525 @@
+/* vdftl_ftl.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Variable-granularity DFTL
+ *
+ * Generalises the block/page bimodal mapping of BDFTL.  Data is placed as in
+ * DFTL, page by page at the current data page, and the page-level map stays
+ * on flash behind the GTD.  Every logical block is a region mapped at one
+ * granularity out of 1, 4, 16, ... pages, up to the block size.  At
+ * granularity g the region is cut into chunks of g pages; a chunk whose
+ * pages are mapped to consecutive physical pages of one block is held by a
+ * single chunk entry in RAM, and its pages need no CMT entries.  Pages of
+ * the other chunks are mapped through the CMT, as in DFTL.
+ *
+ * Chunk entries are taken out of the RAM of the CMT, up to
+ * VDFTL_CHUNK_LIMIT pages of it.  A chunk is folded as soon as a write
+ * completes it and broken again, its pages going back to the CMT, by an
+ * overwrite or trim of one of them.  Whenever that happens the region
+ * moves to the granularity needing the fewest entries (chunk entries plus
+ * page entries outside them) that fits the budget: sequential regions are
+ * promoted step by step, a region with a few overwrites is demoted only as
+ * far as it takes to keep the rest of it in chunks.
+ *
+ * GC copies valid pages in physical order, so the chunks of a victim block
+ * stay contiguous and are only relocated; GC never folds new chunks.  The
+ * moved mappings are written back once per translation page.
+ */
+
+#include <new>
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+FtlImpl_Vdftl::FtlImpl_Vdftl(Controller &controller):
+	FtlImpl_DftlParent(controller),
+	chunkEntries(0),
+	numPromotions(0),
+	numDemotions(0),
+	numBroken(0)
+{
+	for (uint g = 1; g <= BLOCK_SIZE; g *= 4)
+		granularities.push_back(g);
+
+	Region empty;
+	empty.granularity = 1;
+	regions.assign(NUMBER_OF_ADDRESSABLE_BLOCKS, empty);
+	fold_seq.assign((ulong) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE, 0);
+
+	cmtBudget = totalCMTentries;
+	chunkLimit = std::min((long) VDFTL_CHUNK_LIMIT * addressPerPage, cmtBudget / 2);
+
+	printf("Variable-granularity DFTL chunk entries: %lu, largest chunk: %u pages\n", chunkLimit, granularities.back());
+	printf("Using variable-granularity DFTL.\n");
+}
+
+FtlImpl_Vdftl::~FtlImpl_Vdftl(void)
+{
+	return;
+}
+
+enum status FtlImpl_Vdftl::read(Event &event)
+{
+	long dlpn = event.get_logical_address();
+	long ppn;
+
+	if (covered(dlpn))
+	{
+		Region &region = regions[dlpn / BLOCK_SIZE];
+		uint off = dlpn % BLOCK_SIZE;
+
+		event.incr_time_taken(RAM_READ_DELAY);
+		controller.stats.numMemoryRead++;
+		controller.stats.numCacheHits++;
+
+		ppn = region.chunks[off / region.granularity] + off % region.granularity;
+		assert(ppn == trans_map[dlpn]);
+	}
+	else
+	{
+		resolve_mapping(event, false);
+		ppn = trans_map[dlpn];
+	}
+
+	if (ppn == -1)
+	{
+		event.set_address(Address(0, PAGE));
+		event.set_noop(true);
+	}
+	else
+		event.set_address(Address(ppn, PAGE));
+
+	update_memory();
+
+	controller.stats.numFTLRead++;
+
+	return controller.issue(event);
+}
+
+enum status FtlImpl_Vdftl::write(Event &event)
+{
+	long dlpn = event.get_logical_address();
+	long r = dlpn / BLOCK_SIZE;
+	uint off = dlpn % BLOCK_SIZE;
+	bool changed = false;
+
+	/*
+	 * The old page is looked up only once the new one is allocated, which
+	 * may run GC: GC must not move it afterwards.
+	 */
+	if (covered(dlpn))
+	{
+		event.incr_time_taken(RAM_READ_DELAY);
+		controller.stats.numMemoryRead++;
+		controller.stats.numCacheHits++;
+
+		break_chunk(r, off / regions[r].granularity, dlpn);
+		numBroken++;
+		changed = true;
+
+		evict_page_from_cache(event);
+
+		long index = cmt_find(dlpn);
+		if (index == -1)
+			cmt_insert(dlpn, true, true);
+		else
+		{
+			cmt_set_dirty(index);
+			cmt_touch(index);
+		}
+	}
+	else
+	{
+		// Entries unfolded since the last miss may have overfilled the CMT
+		if (cmt > (long) totalCMTentries)
+			evict_page_from_cache(event);
+
+		resolve_mapping(event, true);
+	}
+
+	long free_page = get_free_data_page(event);
+
+	long ppn = trans_map[dlpn];
+	if (ppn != -1)
+		event.set_replace_address(Address(ppn, PAGE));
+
+	update_translation_map(dlpn, free_page);
+	cmt_keep_dirty(event, dlpn);
+
+	event.set_address(Address(free_page, PAGE));
+
+	// Fold the chunk, or at page granularity the group, the write completed
+	Region &region = regions[r];
+	if (region.granularity > 1)
+	{
+		uint c = off / region.granularity;
+		if (region.chunks[c] == -1 && fold_chunk(r, c))
+			changed = true;
+	}
+	else if (granularities.size() > 1 && chunkEntries < chunkLimit)
+	{
+		uint group = granularities[1];
+		if (chunk_base(r * BLOCK_SIZE + off / group * group, group) != -1)
+			changed = true;
+	}
+
+	if (changed)
+		adapt_region(r);
+
+	update_memory();
+
+	controller.stats.numFTLWrite++;
+
+	return controller.issue(event);
+}
+
+enum status FtlImpl_Vdftl::trim(Event &event)
+{
+	long dlpn = event.get_logical_address();
+	long r = dlpn / BLOCK_SIZE;
+
+	event.set_address(Address(0, PAGE));
+
+	long ppn = trans_map[dlpn];
+
+	if (ppn != -1)
+	{
+		bool changed = false;
+
+		if (covered(dlpn))
+		{
+			break_chunk(r, dlpn % BLOCK_SIZE / regions[r].granularity, dlpn);
+			numBroken++;
+			changed = true;
+		}
+
+		Address address = Address(ppn, PAGE);
+		Block *block = controller.get_block_pointer(address);
+		block->invalidate_page(address.page);
+
+		evict_specific_page_from_cache(event, dlpn);
+
+		update_translation_map(dlpn, -1);
+
+		if (changed)
+			adapt_region(r);
+
+		update_memory();
+	}
+
+	controller.stats.numFTLTrim++;
+
+	return controller.issue(event);
+}
+
+void FtlImpl_Vdftl::cleanup_block(Event &event, Block *block)
+{
+	if (block->get_block_type() == MAP)
+	{
+		cleanup_translation_block(event, block);
+		return;
+	}
+
+	// Valid pages as (logical, physical) page pairs, in physical order
+	std::vector<std::pair<long, long> > valid;
+
+	for (uint i=0;i<BLOCK_SIZE;i++)
+	{
+		assert(block->get_state(i) != EMPTY);
+
+		if (block->get_state(i) == VALID)
+		{
+			long ppn = block->get_physical_address()+i;
+			valid.push_back(std::make_pair(reverse_trans_map[ppn], ppn));
+		}
+	}
+
+	std::map<long, long> moved;
+
+	for (uint i=0;i<valid.size();i++)
+	{
+		long dlpn = valid[i].first;
+		long ppn = valid[i].second;
+
+		Event readEvent = Event(READ, event.get_logical_address(), 1, event.get_start_time());
+		readEvent.set_address(Address(ppn, PAGE));
+		readEvent.set_cause(CAUSE_GC);
+
+		if (controller.issue(readEvent) == FAILURE)
+			printf("Data block copy failed.");
+
+		Event writeEvent = Event(WRITE, event.get_logical_address(), 1, event.get_start_time()+readEvent.get_time_taken());
+		long free_page = get_free_data_page(event, false);
+		writeEvent.set_address(Address(free_page, PAGE));
+		writeEvent.set_replace_address(Address(ppn, PAGE));
+		writeEvent.set_payload((char*)page_data + ppn * PAGE_SIZE);
+		writeEvent.set_cause(CAUSE_GC);
+
+		if (controller.issue(writeEvent) == FAILURE)
+			printf("Data block copy failed.");
+
+		event.incr_time_taken(writeEvent.get_time_taken() + readEvent.get_time_taken());
+
+		moved[dlpn] = free_page;
+
+		controller.stats.numFTLRead++;
+		controller.stats.numFTLWrite++;
+		controller.stats.numGCRead++;
+		controller.stats.numGCWrite++;
+	}
+
+	update_translation_pages(event, moved);
+
+	// Chunks under the moved pages follow them
+	long last = -1;
+	for (std::map<long, long>::const_iterator i = moved.begin(); i != moved.end(); ++i)
+		if ((*i).first / BLOCK_SIZE != last)
+		{
+			last = (*i).first / BLOCK_SIZE;
+			relocate_region(last);
+		}
+
+	update_memory();
+}
+
+/* First physical page of lpn .. lpn + length - 1 if they are all mapped to
+ * consecutive pages of one physical block, -1 otherwise */
+long FtlImpl_Vdftl::chunk_base(long lpn, uint length) const
+{
+	long base = trans_map[lpn];
+
+	if (base == -1 || base % BLOCK_SIZE + length > BLOCK_SIZE)
+		return -1;
+	if (trans_map[lpn + length - 1] != base + length - 1)
+		return -1;
+
+	for (uint i = 1; i < length - 1; i++)
+		if (trans_map[lpn + i] != base + i)
+			return -1;
+
+	return base;
+}
+
+bool FtlImpl_Vdftl::covered(long dlpn) const
+{
+	const Region &region = regions[dlpn / BLOCK_SIZE];
+
+	if (region.granularity == 1)
+		return false;
+	return region.chunks[dlpn % BLOCK_SIZE / region.granularity] != -1;
+}
+
+/* Mapping entries the region needs at the given granularity, ignoring the
+ * budget; chunks is set to the number of them that are chunk entries */
+ulong FtlImpl_Vdftl::region_cost(long r, uint granularity, ulong &chunks) const
+{
+	long first = r * BLOCK_SIZE;
+	ulong cost = 0;
+
+	chunks = 0;
+
+	for (uint off = 0; off < BLOCK_SIZE; off += granularity)
+	{
+		uint length = std::min(granularity, BLOCK_SIZE - off);
+
+		if (granularity > 1 && chunk_base(first + off, length) != -1)
+		{
+			chunks++;
+			cost++;
+			continue;
+		}
+
+		for (uint i = 0; i < length; i++)
+			if (trans_map[first + off + i] != -1)
+				cost++;
+	}
+
+	return cost;
+}
+
+/* Move the region to the cheapest granularity its chunks fit the budget at,
+ * staying where it is on a tie */
+void FtlImpl_Vdftl::adapt_region(long r)
+{
+	Region &region = regions[r];
+	ulong stored = 0;
+
+	for (uint c = 0; c < region.chunks.size(); c++)
+		if (region.chunks[c] != -1)
+			stored++;
+
+	uint best = region.granularity;
+	ulong chunks;
+	ulong bestCost = region_cost(r, best, chunks);
+
+	for (uint i = 0; i < granularities.size(); i++)
+	{
+		uint g = granularities[i];
+		if (g == region.granularity)
+			continue;
+
+		ulong cost = region_cost(r, g, chunks);
+		if (cost < bestCost && chunkEntries - stored + chunks <= chunkLimit)
+		{
+			best = g;
+			bestCost = cost;
+		}
+	}
+
+	if (best == region.granularity)
+		return;
+
+	if (best > region.granularity)
+		numPromotions++;
+	else
+		numDemotions++;
+
+	rebuild_region(r, best);
+}
+
+void FtlImpl_Vdftl::rebuild_region(long r, uint granularity)
+{
+	Region &region = regions[r];
+
+	for (uint c = 0; c < region.chunks.size(); c++)
+		if (region.chunks[c] != -1)
+			break_chunk(r, c, -1);
+
+	region.granularity = granularity;
+	region.chunks.assign(granularity > 1 ? (BLOCK_SIZE + granularity - 1) / granularity : 0, -1);
+
+	for (uint c = 0; c < region.chunks.size(); c++)
+		fold_chunk(r, c);
+}
+
+/* Map chunk c by a chunk entry if it is contiguous and the budget allows,
+ * dropping the CMT entries of its pages but not their dirtiness */
+bool FtlImpl_Vdftl::fold_chunk(long r, uint c)
+{
+	Region &region = regions[r];
+	long first = r * BLOCK_SIZE + c * region.granularity;
+	uint length = std::min(region.granularity, BLOCK_SIZE - c * region.granularity);
+
+	if (chunkEntries >= chunkLimit)
+		return false;
+
+	long base = chunk_base(first, length);
+	if (base == -1)
+		return false;
+
+	region.chunks[c] = base;
+	chunkEntries++;
+
+	for (uint i = 0; i < length; i++)
+	{
+		long vpn = first + i;
+		long index = cmt_find(vpn);
+
+		fold_seq[vpn] = 0;
+		if (index != -1)
+		{
+			if (cmt_is_dirty(index))
+				fold_seq[vpn] = tpage_seq[vpn / addressPerPage] + 1;
+			cmt_remove(index);
+		}
+	}
+
+	return true;
+}
+
+/* Drop the entry of chunk c; its mapped pages other than keep go back to
+ * the CMT, dirty unless their translation page was written back since they
+ * were folded.  The CMT may be left overfull until the next eviction. */
+void FtlImpl_Vdftl::break_chunk(long r, uint c, long keep)
+{
+	Region &region = regions[r];
+	long first = r * BLOCK_SIZE + c * region.granularity;
+	uint length = std::min(region.granularity, BLOCK_SIZE - c * region.granularity);
+
+	assert(region.chunks[c] != -1);
+
+	region.chunks[c] = -1;
+	chunkEntries--;
+
+	for (uint i = 0; i < length; i++)
+	{
+		long vpn = first + i;
+		if (vpn != keep && trans_map[vpn] != -1 && cmt_find(vpn) == -1)
+			cmt_insert(vpn, fold_seq[vpn] == tpage_seq[vpn / addressPerPage] + 1, false);
+	}
+}
+
+/* After GC moved pages of the region, point its chunks at their new place,
+ * breaking those that did not stay contiguous */
+void FtlImpl_Vdftl::relocate_region(long r)
+{
+	Region &region = regions[r];
+
+	for (uint c = 0; c < region.chunks.size(); c++)
+	{
+		if (region.chunks[c] == -1)
+			continue;
+
+		long first = r * BLOCK_SIZE + c * region.granularity;
+		uint length = std::min(region.granularity, BLOCK_SIZE - c * region.granularity);
+		long base = chunk_base(first, length);
+
+		if (base != -1)
+			region.chunks[c] = base;
+		else
+		{
+			break_chunk(r, c, -1);
+			numBroken++;
+		}
+	}
+}
+
+/* Chunk entries take their RAM from the CMT */
+void FtlImpl_Vdftl::update_memory()
+{
+	totalCMTentries = cmtBudget - chunkEntries;
+	controller.stats.numMemoryTranslation = (cmt + chunkEntries + numTranslationPages) * entryBytes;
+}
+
+long FtlImpl_Vdftl::get_num_cached_mappings() const
+{
+	return cmt + chunkEntries;
+}
+
+void FtlImpl_Vdftl::print_ftl_statistics()
+{
+	printf("Variable-granularity DFTL:\n");
+	printf("Chunk entries: %lu of %lu\n", chunkEntries, chunkLimit);
+
+	printf("Regions by granularity:");
+	for (uint i = 0; i < granularities.size(); i++)
+	{
+		ulong count = 0;
+		for (ulong r = 0; r < regions.size(); r++)
+			if (regions[r].granularity == granularities[i])
+				count++;
+		printf(" %u: %lu", granularities[i], count);
+	}
+	printf("\n");
+
+	printf("Promotions: %lu Demotions: %lu Broken chunks: %lu\n", numPromotions, numDemotions, numBroken);
+	Block_manager::instance()->print_statistics();
+}
@@ -27,14 +27,16 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <vector>
+#include <deque>
 #include <queue>
 #include <map>
+#include <set>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/member.hpp>
-#include <boost/multi_index/global_fun.hpp>
 #include <boost/multi_index/random_access_index.hpp>
  
 #ifndef _SSD_H
@@ -129,21 +131,48 @@ extern const uint MAP_DIRECTORY_SIZE;
  */
 extern const uint FTL_IMPLEMENTATION;
 
+/*
+ * Spare blocks per die for the page FTL.
+ */
+extern const uint PAGE_SPARE_BLOCKS;
+
 /*
  * LOG page limit for BAST.
  */
 extern const uint BAST_LOG_BLOCK_LIMIT;
 
+/*
+ * Victim policy for BAST log blocks.
+ */
+extern const uint BAST_VICTIM_POLICY;
+
 /*
  * LOG page limit for FAST.
  */
 extern const uint FAST_LOG_BLOCK_LIMIT;
 
+/*
+ * SW log block limit for FAST.
+ */
+extern const uint FAST_SEQUENTIAL_LOG_LIMIT;
+
 /*
  * Number of blocks allowed to be in DFTL Cached Mapping Table.
  */
 extern const uint CACHE_DFTL_LIMIT;
 
+/*
+ * Pages of RAM for learned FTL mapping segments, and their error bound.
+ */
+extern const uint LEARNED_CACHE_LIMIT;
+extern const uint LEARNED_ERROR_BOUND;
+
+/*
+ * Pages of the DFTL cache that variable-granularity DFTL may give to chunk
+ * mappings.
+ */
+extern const uint VDFTL_CHUNK_LIMIT;
+
 /*
  * Parallelism mode
  */
@@ -190,6 +219,25 @@ enum block_state{FREE, ACTIVE, INACTIVE};
  * 	           to free pages in block at merge_address */
 enum event_type{READ, WRITE, ERASE, MERGE, TRIM};
 
+/* Event causes, used to attribute flash traffic
+ * 	host    - a host request, or the page it maps to
+ * 	gc      - garbage collection copies and reclaiming erases
+ * 	merge   - log block merges (switch, partial and full)
+ * 	mapping - translation and map pages read or written back
+ * 	wl      - wear-leveling moves */
+enum event_cause{CAUSE_HOST, CAUSE_GC, CAUSE_MERGE, CAUSE_MAPPING, CAUSE_WL};
+#define NUM_EVENT_CAUSES 5
+
+/* Parts of a host request's response time, see Stats::latency_begin
+ * 	bus wait - waiting for a bus channel
+ * 	mapping  - translation page reads and writebacks on CMT misses
+ * 	gc       - foreground garbage collection
+ * 	merge    - log block switches and merges
+ * 	flash    - the request's own flash read or program
+ * 	other    - the rest: bus transfers and RAM buffering */
+enum latency_part{LATENCY_BUS_WAIT, LATENCY_MAPPING, LATENCY_GC, LATENCY_MERGE, LATENCY_FLASH, LATENCY_OTHER};
+#define NUM_LATENCY_PARTS 6
+
 /* General return status
  * return status for simulator operations that only need to provide general
  * failure notifications */
@@ -208,12 +256,29 @@ enum address_valid{NONE, PACKAGE, DIE, PLANE, BLOCK, PAGE};
  * it should work with.
  * the block types are log, data and map (Directory map usually)
  */
-enum block_type {LOG, DATA, LOG_SEQ};
+enum block_type {LOG, DATA, LOG_SEQ, MAP};
 
 /*
  * Enumeration of the different FTL implementations.
  */
-enum ftl_implementation {IMPL_PAGE, IMPL_BAST, IMPL_FAST, IMPL_DFTL, IMPL_BIMODAL};
+enum ftl_implementation {IMPL_PAGE, IMPL_BAST, IMPL_FAST, IMPL_DFTL, IMPL_BIMODAL, IMPL_TPFTL, IMPL_LEARNED, IMPL_VDFTL};
+
+/*
+ * Log block BAST merges to make room for a new one: a random one, the least
+ * recently written, the one with the fewest valid pages, or one that can be
+ * switched (falling back to the least recently written).
+ */
+enum bast_victim_policy {BAST_VICTIM_RANDOM, BAST_VICTIM_LRU, BAST_VICTIM_FEWEST_VALID, BAST_VICTIM_SWITCH_FIRST};
+
+/*
+ * Block trace formats understood by the trace replayer.
+ * 	msr      - MSR Cambridge CSV (Timestamp,Hostname,Disk,Type,Offset,Size,...)
+ * 	spc      - SNIA/UMass SPC (ASU,LBA,Size,Opcode,Timestamp)
+ * 	blkparse - blkparse default text output, driver issue ('D') actions
+ * 	fio      - fio iolog version 2 or 3
+ * 	binary   - FlashSim binary trace (see BinaryTraceHeader)
+ */
+enum trace_format {TRACE_MSR, TRACE_SPC, TRACE_BLKPARSE, TRACE_FIO, TRACE_BINARY};
 
 
 #define BOOST_MULTI_INDEX_ENABLE_SAFE_MODE 1
@@ -227,8 +292,10 @@ enum ftl_implementation {IMPL_PAGE, IMPL_BAST, IMPL_FAST, IMPL_DFTL, IMPL_BIMODA
  * constructors that accept args
  * (e.g. a Ssd contains a Controller, Ram, Bus, and Packages). */
 class Address;
+class Histogram;
 class Stats;
 class Event;
+class Utilization;
 class Channel;
 class Bus;
 class Page;
@@ -246,11 +313,23 @@ class FtlImpl_Fast;
 class FtlImpl_DftlParent;
 class FtlImpl_Dftl;
 class FtlImpl_BDftl;
+class FtlImpl_Tpftl;
+class FtlImpl_Learned;
+class FtlImpl_Vdftl;
 
 class Ram;
 class Controller;
 class Ssd;
 
+class TraceSource;
+class TraceFile;
+class BinaryTraceFile;
+class BinaryTraceWriter;
+class TraceReplayer;
+class Workload;
+class Sampler;
+class Tracer;
+
 
 
 /* Class to manage physical addresses for the SSD.  It was designed to have
@@ -287,6 +366,37 @@ public:
 	ulong get_linear_address() const;
 };
 
+/* Log-linear latency histogram
+ * Latencies (in simulator time units) are quantized to a fixed resolution
+ * and counted in buckets: values below 2^HISTOGRAM_SUB_BITS units get one
+ * bucket each, larger values share each power of two among
+ * 2^HISTOGRAM_SUB_BITS buckets.  Any recorded value is known to within ~3%
+ * at constant memory, and histograms of equal resolution can be merged. */
+#define HISTOGRAM_SUB_BITS 5
+class Histogram
+{
+public:
+	Histogram(double resolution = 1e-6);
+	void record(double value);
+	void merge(const Histogram &other);
+	void reset(void);
+	double percentile(double pct) const;
+	double get_mean(void) const;
+	double get_max(void) const;
+	double get_sum(void) const;
+	ulong get_count(void) const;
+	void print(const char *name, FILE *stream = stdout) const;
+private:
+	static uint index_of(uint64_t value);
+	static uint64_t value_of(uint index);
+
+	double resolution;
+	std::vector<ulong> counts;
+	ulong count;
+	double sum;
+	uint64_t max_value;
+};
+
 class Stats
 {
 public:
@@ -325,10 +435,42 @@ public:
 	long numMemoryRead;
 	long numMemoryWrite;
 
+	// Host versus flash traffic: host pages written, and flash pages
+	// programmed and blocks erased per event_cause (noop included)
+	long numHostWrite;
+	long numFlashProgram[NUM_EVENT_CAUSES];
+	long numFlashErase[NUM_EVENT_CAUSES];
+
+	// Latency distributions of host requests and of FTL erases/merges
+	Histogram readLatency;
+	Histogram writeLatency;
+	Histogram trimLatency;
+	Histogram eraseLatency;
+	Histogram mergeLatency;
+
+	// Per request contribution of each latency_part to host read and
+	// write response times
+	Histogram readLatencyPart[NUM_LATENCY_PARTS];
+	Histogram writeLatencyPart[NUM_LATENCY_PARTS];
+
 	// Advance statictics
 	double translation_overhead() const;
 	double variance_of_io() const;
 	double cache_hit_ratio() const;
+	long flash_programs() const;
+	long flash_erases() const;
+	double write_amplification() const;
+	double interval_write_amplification() const;
+	void mark_interval();
+
+	// Latency attribution
+	void latency_begin(enum latency_part part, const Event &event);
+	void latency_end(const Event &event);
+	void latency_flash(double time);
+	void latency_page_begin();
+	void latency_page_end(const Event &event);
+	void latency_request_begin();
+	void latency_request_end(enum event_type type, double time_taken);
 
 	// Constructors, maintainance, output, etc.
 	Stats(void);
@@ -339,6 +481,17 @@ public:
 	void write_header(FILE *stream);
 private:
 	void reset();
+	long intervalHostWrite;
+	long intervalFlashProgram;
+
+	// Latency attribution of the page event in progress, and of the
+	// slowest page of the request in progress
+	uint latencyDepth;
+	enum latency_part latencyPart;
+	double latencyMark;
+	double pageLatency[NUM_LATENCY_PARTS];
+	double requestLatency[NUM_LATENCY_PARTS];
+	double requestPageTime;
 };
 
 /* Class to emulate a log block with page-level mapping. */
@@ -347,6 +500,7 @@ class LogPageBlock
 public:
 	LogPageBlock(void);
 	~LogPageBlock(void);
+	void reset(void);
 
 	int *pages;
 	long *aPages;
@@ -355,6 +509,13 @@ public:
 
 	LogPageBlock *next;
 
+	// BAST bookkeeping: owning logical block, LRU links (with next),
+	// victim slot and whether it waits among the switch candidates
+	LogPageBlock *prev;
+	long lba;
+	ulong slot;
+	bool switchQueued;
+
 	bool operator() (const ssd::LogPageBlock& lhs, const ssd::LogPageBlock& rhs) const;
 	bool operator() (const ssd::LogPageBlock*& lhs, const ssd::LogPageBlock*& rhs) const;
 };
@@ -380,6 +541,8 @@ public:
 	double get_time_taken(void) const;
 	double get_bus_wait_time(void) const;
 	bool get_noop(void) const;
+	enum event_cause get_cause(void) const;
+	uint get_request_pages(void) const;
 	Event *get_next(void) const;
 	void set_address(const Address &address);
 	void set_merge_address(const Address &address);
@@ -389,6 +552,8 @@ public:
 	void set_payload(void *payload);
 	void set_event_type(const enum event_type &type);
 	void set_noop(bool value);
+	void set_cause(enum event_cause cause);
+	void set_request_pages(uint pages);
 	void *get_payload(void) const;
 	double incr_bus_wait_time(double time);
 	double incr_time_taken(double time_incr);
@@ -408,6 +573,37 @@ private:
 	void *payload;
 	Event *next;
 	bool noop;
+	enum event_cause cause;
+	uint request_pages;
+};
+
+/* Busy-time accounting for one hardware resource (bus channel, die, plane)
+ * Counts operations, the time spent performing them and the time they
+ * queued before starting, and remembers the first start and last finish so
+ * idle time can be derived against a span of simulated time.  Channels
+ * queue for real; dies and planes are not serialized by the model, so for
+ * them the queue time is how long an operation overlapped earlier ones on
+ * the same unit, i.e. the wait a serializing unit would have imposed. */
+class Utilization
+{
+public:
+	Utilization(void);
+	void record(double start_time, double duration, double queue_time);
+	void record_event(const Event &event, double time_before);
+	void reset(void);
+	ulong get_ops(void) const;
+	double get_busy_time(void) const;
+	double get_queue_time(void) const;
+	double get_first_time(void) const;
+	double get_last_time(void) const;
+	double get_idle_time(double span) const;
+	double get_utilization(double span) const;
+private:
+	ulong ops;
+	double busy_time;
+	double queue_time;
+	double first_time;
+	double last_time;
 };
 
 /* Single bus channel
@@ -428,6 +624,8 @@ public:
 	enum status connect(void);
 	enum status disconnect(void);
 	double ready_time(void);
+	const Utilization &get_utilization(void) const;
+	void reset_utilization(void);
 private:
 	void unlock(double current_time);
 
@@ -448,6 +646,8 @@ private:
 
 	// Stores the highest unlock_time in the vector timings list.
 	double ready_at;
+
+	Utilization usage;
 };
 
 /* Multi-channel bus comprised of Channel class objects
@@ -563,6 +763,8 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	const Utilization &get_utilization(const Address &address) const;
+	void reset_utilization(void);
 private:
 	void update_wear_stats(void);
 	enum status get_next_page(void);
@@ -576,6 +778,7 @@ private:
 	double reg_write_delay;
 	Address next_page;
 	uint free_blocks;
+	Utilization usage;
 };
 
 /* The die is the data storage hardware unit that contains planes and is a flash
@@ -602,6 +805,8 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	const Utilization &get_utilization(const Address &address) const;
+	void reset_utilization(void);
 private:
 	void update_wear_stats(const Address &address);
 	uint size;
@@ -611,6 +816,7 @@ private:
 	uint least_worn;
 	ulong erases_remaining;
 	double last_erase_time;
+	Utilization usage;
 };
 
 /* The package is the highest level data storage hardware unit.  While the
@@ -638,6 +844,8 @@ public:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	const Utilization &get_utilization(const Address &address) const;
+	void reset_utilization(void);
 private:
 	void update_wear_stats (const Address &address);
 	uint size;
@@ -676,16 +884,20 @@ public:
 	// Usual suspects
 	Address get_free_block(Event &event);
 	Address get_free_block(block_type btype, Event &event);
+	Address get_free_block(block_type btype, Event &event, uint die);
 	void invalidate(Address address, block_type btype);
 	void print_statistics();
 	void insert_events(Event &event);
 	void promote_block(block_type to_type);
 	bool is_log_full();
-	void erase_and_invalidate(Event &event, Address &address, block_type btype);
+	void erase_and_invalidate(Event &event, Address &address, block_type btype, enum event_cause cause = CAUSE_GC);
 	int get_num_free_blocks();
+	ulong get_num_log_blocks() const;
 
 	// Used to update GC on used pages in blocks.
 	void update_block(Block * b);
+	void record_program(const Event &event);
+	void record_erase(const Event &event);
 
 	// Singleton
 	static Block_manager *instance();
@@ -700,6 +912,13 @@ public:
 
 private:
 	void get_page_block(Address &address, Event &event);
+	Block *select_victim();
+	void claim_block(Address &address, block_type btype);
+
+	// Die-local allocation and greedy GC (page-mapped FTL)
+	ulong take_die_block(uint die);
+	Block *select_die_victim(uint die);
+	void collect_die(Event &event, uint die);
 	static bool block_comparitor_simple (Block const *x,Block const *y);
 
 	FtlParent *ftl;
@@ -707,6 +926,7 @@ private:
 	ulong data_active;
 	ulong log_active;
 	ulong logseq_active;
+	ulong map_active;
 
 	ulong max_log_blocks;
 	ulong max_blocks;
@@ -733,6 +953,11 @@ private:
 	std::vector<Block*> free_list;
 	std::vector<Block*> invalid_list;
 
+	// Free blocks of every die, by linear address, and their total
+	std::vector<std::deque<ulong> > die_free_list;
+	ulong die_free_blocks;
+	bool die_collecting;
+
 	// Counter for returning the next free page.
 	ulong directoryCurrentPage;
 	// Address on the current cached page in SRAM.
@@ -762,6 +987,8 @@ public:
 	virtual void cleanup_block(Event &event, Block *block);
 
 	virtual void print_ftl_statistics();
+	virtual long get_num_cached_mappings() const;
+	virtual ulong get_logical_pages() const;
 
 	friend class Block_manager;
 
@@ -784,11 +1011,21 @@ public:
 	enum status read(Event &event);
 	enum status write(Event &event);
 	enum status trim(Event &event);
+	void cleanup_block(Event &event, Block *block);
+	ulong get_logical_pages() const;
 private:
-	ulong currentPage;
-	ulong numPagesActive;
-	bool *trim_map;
+	long get_free_page(Event &event, uint die, bool gc);
+	uint next_die();
+	bool in_range(Event &event, const char *func);
+
 	long *map;
+	long *reverse_map;
+	ulong logicalPages;
+
+	// Last page written at every die, for host writes and GC copies
+	std::vector<long> write_points;
+	std::vector<long> gc_points;
+	ulong currentDie;
 };
 
 class FtlImpl_Bast : public FtlParent
@@ -807,6 +1044,11 @@ private:
 	void dispose_logblock(LogPageBlock *logBlock, long lba);
 	void allocate_new_logblock(LogPageBlock *logBlock, long lba, Event &event);
 
+	long select_victim();
+	void log_touch(LogPageBlock *logBlock);
+	void set_log_pages(LogPageBlock *logBlock, int numPages);
+	bool is_switchable(LogPageBlock *logBlock);
+
 	bool is_sequential(LogPageBlock* logBlock, long lba, Event &event);
 	bool random_merge(LogPageBlock *logBlock, long lba, Event &event);
 
@@ -816,6 +1058,18 @@ private:
 
 	int addressShift;
 	int addressSize;
+
+	// Log blocks in write order (head least recent) and in victim slots
+	LogPageBlock *lru_head;
+	LogPageBlock *lru_tail;
+	std::vector<LogPageBlock*> log_slots;
+
+	// By valid pages, and the full ones that can be switched
+	std::set<std::pair<int, long> > log_valid;
+	std::deque<long> switch_candidates;
+
+	// Disposed log blocks, reused with their page arrays
+	std::vector<LogPageBlock*> log_pool;
 };
 
 class FtlImpl_Fast : public FtlParent
@@ -828,25 +1082,45 @@ public:
 	enum status trim(Event &event);
 private:
 	void initialize_log_pages();
+	void drop_log_index(LogPageBlock *logBlock);
 
 	std::map<long, LogPageBlock*> log_map;
 
 	long *data_list;
 	bool *pin_list;
 
+	// Latest copy of every logical page in the RW log blocks, if any
+	struct LogIndex
+	{
+		LogPageBlock *block;
+		int offset;
+	};
+	std::vector<LogIndex> log_index;
+
 	bool write_to_log_block(Event &event, long logicalBlockAddress);
 
-	void switch_sequential(Event &event);
-	void merge_sequential(Event &event);
+	// A SW log block and the logical block it is filling
+	struct SequentialLog
+	{
+		long lba;
+		Address address;
+		uint offset;
+		ulong lastWrite;
+	};
+
+	int find_sequential(long logicalBlockAddress);
+	int select_sequential(long logicalBlockAddress);
+	void open_sequential(Event &event, SequentialLog &log, long logicalBlockAddress);
+	void switch_sequential(Event &event, SequentialLog &log);
+	void merge_sequential(Event &event, SequentialLog &log);
 	bool random_merge(LogPageBlock *logBlock, Event &event);
 
 	void update_map_block(Event &event);
 
 	void print_ftl_statistics();
 
-	long sequential_logicalblock_address;
-	Address sequential_address;
-	uint sequential_offset;
+	std::vector<SequentialLog> sequential_logs;
+	ulong sequential_clock;
 
 	uint log_page_next;
 	LogPageBlock *log_pages;
@@ -865,56 +1139,79 @@ public:
 	virtual enum status read(Event &event) = 0;
 	virtual enum status write(Event &event) = 0;
 	virtual enum status trim(Event &event) = 0;
+	long get_num_cached_mappings() const;
 protected:
-	struct MPage {
+	/* Cached Mapping Table entry.  Entries live in a pool, are chained in
+	 * their hash bucket through hash_next and kept in LRU order through
+	 * lru_prev/lru_next (indices into the pool, -1 terminates).  An entry
+	 * is dirty while dirty is set and its translation page has not been
+	 * written back since (dirty_seq == tpage_seq of the translation page). */
+	struct CmtEntry {
 		long vpn;
-		long ppn;
-		double create_ts;
-		double modified_ts;
-		double last_visited_time;
-		bool cached;
-
-		MPage(long vpn);
+		bool dirty;
+		ulong dirty_seq;
+		long hash_next;
+		long lru_prev;
+		long lru_next;
 	};
 
 	long int cmt;
 
-	static double mpage_last_visited_time_compare(const MPage& mpage);
+	// Global Mapping Table: logical page -> physical page, -1 if unmapped
+	long *trans_map;
+	long *reverse_trans_map;
 
-	typedef boost::multi_index_container<
-		FtlImpl_DftlParent::MPage,
-			boost::multi_index::indexed_by<
-		    // sort by MPage::operator<
-    			boost::multi_index::random_access<>,
+	// Cached Mapping Table
+	std::vector<CmtEntry> cmt_entries;
+	std::vector<long> cmt_buckets;
+	long cmt_free;
+	long cmt_lru_head;
+	long cmt_lru_tail;
 
-    			// Sort by last visited time
-    			boost::multi_index::ordered_non_unique<boost::multi_index::global_fun<const FtlImpl_DftlParent::MPage&,double,&FtlImpl_DftlParent::mpage_last_visited_time_compare> >
-		  >
-		> trans_set;
+	// Global Translation Directory: translation page -> physical page,
+	// -1 while the translation page has never been written
+	long *gtd;
+	long numTranslationPages;
 
-	typedef trans_set::nth_index<0>::type MpageByID;
-	typedef trans_set::nth_index<1>::type MpageByLastVisited;
+	// Write-back generation of every translation page
+	std::vector<ulong> tpage_seq;
 
-	trans_set trans_map;
-	long *reverse_trans_map;
+	long cmt_find(long vpn) const;
+	long cmt_insert(long vpn, bool dirty, bool hot);
+	void cmt_remove(long index);
+	void cmt_set_dirty(long index);
+	bool cmt_is_dirty(long index) const;
+	void cmt_keep_dirty(Event &event, long vpn);
 
-	void consult_GTD(long dppn, Event &event);
-	void reset_MPage(FtlImpl_DftlParent::MPage &mpage);
+	// Replacement policy, plain LRU over all cached entries
+	virtual void cmt_link(long index, bool hot);
+	virtual void cmt_unlink(long index);
+	virtual void cmt_touch(long index);
+	virtual long cmt_victim();
 
-	void resolve_mapping(Event &event, bool isWrite);
-	void update_translation_map(FtlImpl_DftlParent::MPage &mpage, long ppn);
+	void consult_GTD(long dlpn, Event &event);
+
+	virtual void resolve_mapping(Event &event, bool isWrite);
+	void update_translation_map(long vpn, long ppn);
 
-	bool lookup_CMT(long dlpn, Event &event);
+	long lookup_CMT(long dlpn, Event &event);
 
 	long get_free_data_page(Event &event);
 	long get_free_data_page(Event &event, bool insert_events);
+	long get_free_translation_page(Event &event);
+
+	void write_translation_page(Event &event, long mlpn);
+	void update_translation_pages(Event &event, const std::map<long, long> &moved);
+	void cleanup_translation_block(Event &event, Block *block);
 
 	void evict_page_from_cache(Event &event);
 	void evict_specific_page_from_cache(Event &event, long lba);
+	void evict_entry(Event &event, long index);
 
 	// Mapping information
 	int addressPerPage;
 	int addressSize;
+	int entryBytes;
 	uint totalCMTentries;
 
 	// Current storage
@@ -952,6 +1249,7 @@ private:
 		BPage();
 	};
 
+
 	BPage *block_map;
 	bool *trim_map;
 
@@ -963,6 +1261,154 @@ private:
 	void print_ftl_statistics();
 };
 
+/* TPFTL: DFTL with a translation-page-aware CMT
+ * Cached entries are grouped by translation page, with an LRU list of
+ * entries inside every page and an LRU list of pages.  A miss loads the
+ * mappings of the rest of the request found in the same translation page,
+ * and a write back cleans all dirty entries of that page at once. */
+class FtlImpl_Tpftl : public FtlImpl_Dftl
+{
+public:
+	FtlImpl_Tpftl(Controller &controller);
+	~FtlImpl_Tpftl();
+	void print_ftl_statistics();
+protected:
+	void resolve_mapping(Event &event, bool isWrite);
+
+	void cmt_link(long index, bool hot);
+	void cmt_unlink(long index);
+	void cmt_touch(long index);
+	long cmt_victim();
+private:
+	struct TpNode {
+		long head;
+		long tail;
+		long count;
+		long prev;
+		long next;
+	};
+
+	void tp_link(long mlpn, bool hot);
+	void tp_unlink(long mlpn);
+
+	std::vector<TpNode> tp_nodes;
+	long tp_lru_head;
+	long tp_lru_tail;
+
+	ulong numPrefetched;
+};
+
+/* Learned-index FTL (LeaFTL style)
+ * Page-level mappings are stored on flash in translation pages as in DFTL,
+ * but the controller RAM caches them as piecewise-linear segments, learned
+ * per translation page with a bounded prediction error.  A sequential run
+ * of any length costs one segment.  A misprediction is caught by the OOB
+ * area of the predicted page and costs one more flash read.  GC moves valid
+ * pages in logical order, which merges fragmented segments. */
+#define LEARNED_SEGMENT_BYTES 8
+class FtlImpl_Learned : public FtlImpl_DftlParent
+{
+public:
+	FtlImpl_Learned(Controller &controller);
+	~FtlImpl_Learned();
+	enum status read(Event &event);
+	enum status write(Event &event);
+	enum status trim(Event &event);
+	void cleanup_block(Event &event, Block *block);
+	void print_ftl_statistics();
+	long get_num_cached_mappings() const;
+private:
+	/* predicts lpn .. lpn + length - 1 as ppn + round(slope * offset) */
+	struct Segment {
+		long lpn;
+		long ppn;
+		double slope;
+		uint length;
+	};
+
+	/* Segments learned from one translation page, resident or not */
+	struct SegmentGroup {
+		std::vector<Segment> segments;
+		bool loaded;
+		bool stale;
+		bool dirty;
+		long prev;
+		long next;
+	};
+
+	void load_group(Event &event, long mlpn);
+	void evict_groups(Event &event, long keep);
+	void learn_group(long mlpn);
+	long predict(Event &event, long dlpn);
+	void mark_updated(long dlpn);
+	void update_memory();
+
+	void group_link(long mlpn);
+	void group_unlink(long mlpn);
+
+	std::vector<SegmentGroup> groups;
+	long group_lru_head;
+	long group_lru_tail;
+
+	long ramUsed;
+	long ramLimit;
+	long numSegments;
+
+	ulong numLookups;
+	ulong numMispredictions;
+	ulong numLearned;
+};
+
+/* Variable-granularity DFTL
+ * Every logical block is a region mapped in chunks of 1, 4, 16, ... pages.
+ * A chunk whose pages sit contiguously inside one physical block is mapped
+ * by a single entry kept in RAM; the other pages go through the CMT as in
+ * DFTL.  Regions move to the granularity that needs the fewest entries. */
+class FtlImpl_Vdftl : public FtlImpl_DftlParent
+{
+public:
+	FtlImpl_Vdftl(Controller &controller);
+	~FtlImpl_Vdftl();
+	enum status read(Event &event);
+	enum status write(Event &event);
+	enum status trim(Event &event);
+	void cleanup_block(Event &event, Block *block);
+	void print_ftl_statistics();
+	long get_num_cached_mappings() const;
+private:
+	/* chunks[c] is the first physical page of chunk c, -1 while it is not
+	 * mapped by a chunk entry */
+	struct Region {
+		uint granularity;
+		std::vector<long> chunks;
+	};
+
+	long chunk_base(long lpn, uint length) const;
+	bool covered(long dlpn) const;
+	ulong region_cost(long r, uint granularity, ulong &chunks) const;
+	void adapt_region(long r);
+	void rebuild_region(long r, uint granularity);
+	bool fold_chunk(long r, uint c);
+	void break_chunk(long r, uint c, long keep);
+	void relocate_region(long r);
+	void update_memory();
+
+	std::vector<Region> regions;
+	std::vector<uint> granularities;
+
+	// Write-back generation + 1 of the translation page a page under a
+	// chunk was dirty in, 0 if its mapping on flash is up to date
+	std::vector<ulong> fold_seq;
+
+	long cmtBudget;
+	ulong chunkEntries;
+	ulong chunkLimit;
+
+	ulong numPromotions;
+	ulong numDemotions;
+	ulong numBroken;
+};
+
 
 /* This is a basic implementation that only provides delay updates to events
  * based on a delay value multiplied by the size (number of pages) needed to
@@ -1000,6 +1446,8 @@ public:
 	friend class FtlImpl_DftlParent;
 	friend class FtlImpl_Dftl;
 	friend class FtlImpl_BDftl;
+	friend class FtlImpl_Learned;
+	friend class FtlImpl_Vdftl;
 	friend class Block_manager;
 
 	Stats stats;
@@ -1018,6 +1466,9 @@ private:
 	ssd::uint get_num_valid(const Address &address) const;
 	ssd::uint get_num_invalid(const Address &address) const;
 	Block *get_block_pointer(const Address & address);
+	enum status lock_bus(Event &event, double start_time, double duration, const char *name);
+	enum status flash(Event &event);
+	enum status buffer(Event &event);
 	Ssd &ssd;
 	FtlParent *ftl;
 };
@@ -1039,10 +1490,19 @@ public:
 	void write_statistics(FILE *stream);
 	void write_header(FILE *stream);
 	const Controller &get_controller(void) const;
+	void set_sampler(Sampler *sampler);
+	void set_tracer(Tracer *tracer);
 
 	void print_ftl_statistics();
+	void print_utilization(FILE *stream = stdout);
+	double utilization_span(void);
+	void utilization_summary(enum address_valid level, double span, double &mean, double &min, double &max, double &queue);
+	const Utilization &get_utilization(const Address &address);
 	double ready_at(void);
 private:
+	double event_arrive_page(enum event_type type, ulong logical_address, uint request_pages, double start_time, void *buffer);
+	void request_done(enum event_type type, ulong logical_address, uint size, double start_time, double time_taken);
+	void reset_utilization(void);
 	enum status read(Event &event);
 	enum status write(Event &event);
 	enum status erase(Event &event);
@@ -1070,6 +1530,10 @@ private:
 	ulong erases_remaining;
 	ulong least_worn;
 	double last_erase_time;
+	void *result_buffer;
+	uint result_buffer_pages;
+	Sampler *sampler;
+	Tracer *tracer;
 };
 
 class RaidSsd
@@ -1094,6 +1558,361 @@ private:
 	Ssd *Ssds;
 
 };
+/* A single host request read out of a block trace.  Offsets and sizes are
+ * in bytes and the time is in seconds, as found in the trace; the replayer
+ * converts them to pages and simulator time units. */
+struct TraceRecord
+{
+	double time;
+	enum event_type type;
+	ulong offset;
+	uint size;
+	uint stream;
+};
+
+/* Sequential stream of trace records.  Sources only ever hold the record
+ * being parsed, so traces of any length replay in bounded memory. */
+class TraceSource
+{
+public:
+	virtual ~TraceSource(void) {}
+	virtual bool next(TraceRecord &record) = 0;
+	virtual void rewind(void) = 0;
+};
+
+/* Text trace read through a read-only mapping of the whole file.  Lines are
+ * handed to the format parser one at a time, and the pages already consumed
+ * are periodically released so resident memory stays bounded regardless of
+ * the trace size. */
+class TraceFile : public TraceSource
+{
+public:
+	TraceFile(const char *path, enum trace_format format);
+	~TraceFile(void);
+	bool next(TraceRecord &record);
+	void rewind(void);
+private:
+	bool parse_line(const char *line, TraceRecord &record);
+	bool parse_msr(const char *line, TraceRecord &record);
+	bool parse_spc(const char *line, TraceRecord &record);
+	bool parse_blkparse(const char *line, TraceRecord &record);
+	bool parse_fio(const char *line, TraceRecord &record);
+
+	enum trace_format format;
+	int fd;
+	char *map;
+	size_t length;
+	size_t position;
+	size_t released;
+	uint fio_version;
+	double fio_time;
+};
+
+/* Binary trace format
+ * A fixed-size header followed by fixed-size records, all little endian.
+ * Times and offsets are delta encoded against the previous record (the
+ * first record against the header base values), so a record decodes with
+ * two additions and no parsing.  Time deltas too large for a record are
+ * carried by preceding NOP records.  Times never go backwards: records of
+ * unsorted traces are clamped to the time of the record before. */
+#define BINARY_TRACE_MAGIC "FSBT"
+#define BINARY_TRACE_VERSION 1
+
+enum binary_trace_op {BT_READ, BT_WRITE, BT_TRIM, BT_NOP};
+
+struct __attribute__((__packed__)) BinaryTraceHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t source_format;		/* trace_format the trace was converted from */
+	uint32_t time_unit;		/* length of one time unit, in nanoseconds */
+	uint64_t base_time;		/* time of the first record, in time units */
+	uint64_t base_offset;		/* offset of the first record, in bytes */
+	uint64_t num_records;		/* including NOP records */
+	uint8_t reserved[24];
+};
+
+struct __attribute__((__packed__)) BinaryTraceRecord
+{
+	uint32_t time_delta;		/* time units since the previous record */
+	uint32_t size;			/* bytes */
+	int64_t offset_delta;		/* bytes from the previous record's offset */
+	uint32_t stream;		/* stream, tenant or disk ID */
+	uint8_t op;			/* binary_trace_op */
+	uint8_t flags;
+	uint16_t reserved;
+};
+
+/* Binary trace read straight out of a read-only mapping; records are
+ * decoded in place without any allocation. */
+class BinaryTraceFile : public TraceSource
+{
+public:
+	BinaryTraceFile(const char *path);
+	~BinaryTraceFile(void);
+	bool next(TraceRecord &record);
+	void rewind(void);
+	const BinaryTraceHeader &get_header(void) const;
+private:
+	int fd;
+	char *map;
+	size_t length;
+	const BinaryTraceHeader *header;
+	const BinaryTraceRecord *records;
+	uint64_t index;
+	size_t released;
+	uint64_t time;
+	uint64_t offset;
+	double seconds_per_unit;
+};
+
+/* Writes a binary trace record by record.  The header is completed once
+ * the last record is known, in close(). */
+class BinaryTraceWriter
+{
+public:
+	BinaryTraceWriter(const char *path, enum trace_format source_format, uint32_t time_unit);
+	~BinaryTraceWriter(void);
+	void append(const TraceRecord &record);
+	void close(void);
+	uint64_t get_num_records(void) const;
+private:
+	void write_record(const BinaryTraceRecord &record);
+
+	FILE *file;
+	BinaryTraceHeader header;
+	uint64_t time;
+	uint64_t offset;
+};
+
+TraceSource *open_trace(const char *path, enum trace_format format);
+bool trace_format_from_name(const char *name, enum trace_format &format);
+
+/* Replays a trace source against a Ssd.
+ * In open-loop mode (queue depth 0) every request arrives at its trace
+ * timestamp, multiplied by the time scale.  In closed-loop mode timestamps
+ * are ignored and a fixed number of requests is kept outstanding: each one
+ * is issued the moment an earlier one completes.
+ * Byte offsets are turned into logical pages, shifted by the LBA offset and
+ * wrapped by the LBA modulo (which defaults to the addressable space). */
+class TraceReplayer
+{
+public:
+	TraceReplayer(Ssd &ssd, TraceSource &source);
+	void set_time_units(double units_per_second);
+	void set_time_scale(double scale);
+	void set_lba_offset(ulong pages);
+	void set_lba_modulo(ulong pages);
+	void set_queue_depth(uint depth);
+	void set_think_time(double seconds);
+	ulong replay(ulong max_requests = 0);
+	void print_statistics(FILE *stream = stdout);
+	double get_end_time(void) const;
+private:
+	double issue(const TraceRecord &record, double start_time);
+
+	Ssd &ssd;
+	TraceSource &source;
+	double time_units;
+	double time_scale;
+	ulong lba_offset;
+	ulong lba_modulo;
+	uint queue_depth;
+	double think_time;
+
+	double first_time;
+	double end_time;
+	ulong num_requests[TRIM + 1];
+	ulong num_pages[TRIM + 1];
+	double total_response[TRIM + 1];
+	double max_response[TRIM + 1];
+};
+
+/* Synthetic workload generator
+ * Generates requests from a small fio-like job description, either read
+ * from a job file (key=value lines, '#' or ';' comments, [section] headers
+ * ignored) or given key by key through set().  Understood keys:
+ * 	rw                  read, write, trim, randread, randwrite, randtrim,
+ * 	                    readwrite (rw), randrw
+ * 	rwmixread           percentage of reads in mixed modes (default 50)
+ * 	trimratio           percentage of requests turned into trims (default 0)
+ * 	bs                  block size, e.g. 4k (default one page)
+ * 	bssplit             block size distribution, e.g. 4k/60:16k/30:64k/10
+ * 	offset, size        address range, in bytes or percent of the device
+ * 	random_distribution random, zipf:THETA or hotcold:HOT_PCT/ACCESS_PCT
+ * 	iodepth             requests kept outstanding (closed loop, default 1)
+ * 	thinktime           microseconds between a completion and the next issue
+ * 	rate_iops           fixed arrival rate; replays open loop when set
+ * 	number_ios          requests per run (default: one pass over size)
+ * 	randseed            seed, runs with equal seeds are identical
+ * As a TraceSource it is driven by a TraceReplayer; configure() hands the
+ * job's queue depth and think time to the replayer.  Create workloads after
+ * load_config(), as ranges are resolved against the configured device. */
+class Workload : public TraceSource
+{
+public:
+	Workload(void);
+	Workload(const char *path);
+	bool set(const char *key, const char *value);
+	bool next(TraceRecord &record);
+	void rewind(void);
+	void configure(TraceReplayer &replayer) const;
+	ulong get_number_ios(void) const;
+	void print(FILE *stream = stdout) const;
+private:
+	struct bs_entry {
+		uint size;
+		double cumulative;
+	};
+	enum workload_distribution {DIST_UNIFORM, DIST_ZIPF, DIST_HOTCOLD};
+
+	inline uint64_t random(void);
+	inline double random_double(void);
+	ulong next_page(uint pages);
+	ulong zipf_rank(void);
+	double zipf_h(double x) const;
+	double zipf_h_integral(double x) const;
+	double zipf_h_integral_inverse(double x) const;
+
+	/* job description */
+	bool sequential;
+	bool has_reads;
+	bool has_writes;
+	bool has_trims;
+	double read_mix;
+	double trim_ratio;
+	std::vector<bs_entry> block_sizes;
+	double offset_bytes;
+	double offset_percent;
+	double size_bytes;
+	double size_percent;
+	enum workload_distribution distribution;
+	double zipf_theta;
+	double hot_fraction;
+	double hot_access;
+	uint iodepth;
+	double think_time;
+	double rate_iops;
+	ulong number_ios;
+	uint64_t seed;
+
+	/* generator state */
+	ulong span_pages;
+	ulong first_page;
+	ulong hot_pages;
+	ulong cursor;
+	ulong issued;
+	ulong limit;
+	uint64_t state[2];
+	ulong zipf_stride;
+	double zipf_h_integral_x1;
+	double zipf_h_integral_n;
+	double zipf_s;
+};
+
+/* Periodic sampler of internal device state
+ * Attached to a Ssd, it is told about every finished host request and
+ * writes one row of metrics per interval, either of simulated time (rows
+ * then line up with the interval boundaries, idle intervals included) or
+ * of a fixed number of requests.  Each row holds the host traffic of the
+ * interval, the free/log block counts, mapping cache occupancy, the flash
+ * writes and erases of the interval and the interval and running write
+ * amplification.  Rows go to a ';'-separated CSV file, or to a binary
+ * file: SAMPLE_BINARY_MAGIC, uint32 version, uint32 column count, the
+ * NUL-terminated column names and then the rows as arrays of doubles. */
+enum sample_format {SAMPLE_CSV, SAMPLE_BINARY};
+#define SAMPLE_BINARY_MAGIC "FSSP"
+#define SAMPLE_BINARY_VERSION 1
+class Sampler
+{
+public:
+	Sampler(Ssd &ssd, const char *path, enum sample_format format = SAMPLE_CSV);
+	~Sampler(void);
+	void set_interval_time(double time);
+	void set_interval_requests(ulong requests);
+	void request_done(enum event_type type, uint size, double start_time, double time_taken);
+	void flush(void);
+	ulong get_num_samples(void) const;
+private:
+	void sample(double time);
+	void write_header(void);
+
+	Ssd &ssd;
+	FILE *file;
+	enum sample_format format;
+	double interval_time;
+	ulong interval_requests;
+	bool started;
+	double next_time;
+	double last_time;
+	ulong num_samples;
+
+	/* current interval */
+	ulong requests;
+	ulong pages[TRIM + 1];
+	double total_latency;
+
+	/* counter values at the start of the current interval */
+	long last_flash_writes;
+	long last_erases;
+	ulong host_writes;
+	long first_flash_writes;
+};
+
+/* Chrome trace-event export of the simulated hardware
+ * Attached to an Ssd, the tracer writes every operation Controller::issue
+ * performs as a complete ("X") trace event: channel reservations, flash
+ * reads, programs, erases and merges on their die and RAM buffering.  Each
+ * record carries the ID of the host request it was issued for and the
+ * cause of its event.  Host requests get a track of their own, and so do
+ * the GC, merge and mapping phases within them (first to last operation of
+ * that cause).  Units the model does not serialize may overlap; their
+ * operations are spread over extra lanes of the unit's track.  Records are
+ * formatted straight into a TRACER_BUFFER_SIZE buffer that is written out
+ * when full, so tracing takes no lock, allocation or I/O per operation.
+ * Simulated time is multiplied by time_scale to get the microseconds of
+ * the trace format; the file opens in chrome://tracing or ui.perfetto.dev. */
+#define TRACER_BUFFER_SIZE (1 << 20)
+#define TRACER_RECORD_MAX 512
+#define TRACER_MAX_LANES 32
+class Tracer
+{
+public:
+	Tracer(Ssd &ssd, const char *path, double time_scale = 1000.0);
+	~Tracer(void);
+	void request_begin(void);
+	void request_end(enum event_type type, ulong logical_address, uint size, double start_time, double time_taken);
+	void channel(const Event &event, const char *name, double start_time, double duration, double wait);
+	void flash(const Event &event, double start_time, double duration);
+	void ram(const Event &event, double start_time, double duration);
+	void flush(void);
+	ulong get_num_records(void) const;
+	ulong get_num_requests(void) const;
+private:
+	uint lane(uint track, double start_time, double duration);
+	void record(uint track, double start_time, double duration, const char *name, const char *category, const char *args, ...);
+	void append(const char *format, ...);
+	void phase(const Event &event, double start_time, double duration);
+	void name_track(uint track, uint lane);
+
+	Ssd &ssd;
+	FILE *file;
+	double time_scale;
+	char *buffer;
+	size_t used;
+	ulong num_records;
+	ulong request;
+
+	/* per track, the finish time of the last operation in each lane */
+	std::vector<std::vector<double> > lanes;
+
+	/* first start and last finish of the operations of each cause within
+	 * the current request */
+	double phase_start[NUM_EVENT_CAUSES];
+	double phase_end[NUM_EVENT_CAUSES];
+	ulong phase_ops[NUM_EVENT_CAUSES];
+};
+
 } /* end namespace ssd */
 
 #endif
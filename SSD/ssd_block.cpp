@@ -159,6 +159,8 @@ enum status Block::_erase(Event &event)
 		Block_manager::instance()->update_block(this);
 	}
 
+	Block_manager::instance()->record_erase(event);
+
 	return SUCCESS;
 }
 
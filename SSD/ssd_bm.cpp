@@ -40,6 +40,7 @@ Block_manager::Block_manager(FtlParent *ftl) : ftl(ftl)
 
 	data_active = 0;
 	log_active = 0;
+	map_active = 0;
 
 	current_writing_block = -2;
 
@@ -48,6 +49,26 @@ Block_manager::Block_manager(FtlParent *ftl) : ftl(ftl)
 	simpleCurrentFree = 0;
 
 	active_cost.reserve(NUMBER_OF_ADDRESSABLE_BLOCKS);
+
+	/*
+	 * The page-mapped FTL allocates per die. Every die starts with all
+	 * its blocks free, listed plane by plane in turn so that consecutive
+	 * blocks of a die land on different planes.
+	 */
+	die_free_blocks = 0;
+	die_collecting = false;
+
+	if (FTL_IMPLEMENTATION == IMPL_PAGE)
+	{
+		die_free_list.resize(SSD_SIZE * PACKAGE_SIZE);
+		for (uint die = 0; die < die_free_list.size(); die++)
+			for (uint block = 0; block < PLANE_SIZE; block++)
+				for (uint plane = 0; plane < DIE_SIZE; plane++)
+				{
+					die_free_list[die].push_back(((ulong) (die * DIE_SIZE + plane) * PLANE_SIZE + block) * BLOCK_SIZE);
+					die_free_blocks++;
+				}
+	}
 }
 
 Block_manager::~Block_manager(void)
@@ -140,9 +161,10 @@ void Block_manager::print_statistics()
 	printf("-----------------\n");
 	printf("Log blocks:  %lu\n", log_active);
 	printf("Data blocks: %lu\n", data_active);
-	printf("Free blocks: %lu\n", (max_blocks - (simpleCurrentFree/BLOCK_SIZE)) + free_list.size());
+	printf("Map blocks:  %lu\n", map_active);
+	printf("Free blocks: %i\n", get_num_free_blocks());
 	printf("Invalid blocks: %lu\n", invalid_list.size());
-	printf("Free2 blocks: %lu\n", (unsigned long int)invalid_list.size() + (unsigned long int)log_active + (unsigned long int)data_active - (unsigned long int)free_list.size());
+	printf("Free2 blocks: %lu\n", (unsigned long int)invalid_list.size() + (unsigned long int)log_active + (unsigned long int)data_active + (unsigned long int)map_active - (unsigned long int)free_list.size());
 	printf("-----------------\n");
 
 
@@ -160,6 +182,9 @@ void Block_manager::invalidate(Address address, block_type type)
 	case LOG:
 		log_active--;
 		break;
+	case MAP:
+		map_active--;
+		break;
 	case LOG_SEQ:
 		break;
 	}
@@ -172,13 +197,15 @@ void Block_manager::invalidate(Address address, block_type type)
 void Block_manager::insert_events(Event &event)
 {
 	// Calculate if GC should be activated.
-	float used = (int)invalid_list.size() + (int)log_active + (int)data_active - (int)free_list.size();
+	float used = (int)invalid_list.size() + (int)log_active + (int)data_active + (int)map_active - (int)free_list.size();
 	float total = NUMBER_OF_ADDRESSABLE_BLOCKS;
 	float ratio = used/total;
 
 	if (ratio < 0.90) // Magic number
 		return;
 
+	ftl->controller.stats.latency_begin(LATENCY_GC, event);
+
 	uint num_to_erase = 5; // More Magic!
 
 	//printf("%i %i %i\n", invalid_list.size(), log_active, data_active);
@@ -188,6 +215,7 @@ void Block_manager::insert_events(Event &event)
 	{
 		Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
 		erase_event.set_address(Address(invalid_list.back()->get_physical_address(), BLOCK));
+		erase_event.set_cause(CAUSE_GC);
 		if (ftl->controller.issue(erase_event) == FAILURE) {	assert(false);}
 		event.incr_time_taken(erase_event.get_time_taken());
 
@@ -200,52 +228,100 @@ void Block_manager::insert_events(Event &event)
 
 	num_insert_events++;
 
-	if (FTL_IMPLEMENTATION == IMPL_DFTL || FTL_IMPLEMENTATION == IMPL_BIMODAL)
+	if (FTL_IMPLEMENTATION == IMPL_DFTL || FTL_IMPLEMENTATION == IMPL_BIMODAL || FTL_IMPLEMENTATION == IMPL_TPFTL || FTL_IMPLEMENTATION == IMPL_LEARNED || FTL_IMPLEMENTATION == IMPL_VDFTL)
 	{
 
-		ActiveByCost::iterator it = active_cost.get<1>().end();
-		--it;
+		Block *blockErase;
 
-
-		while (num_to_erase != 0 && (*it)->get_pages_invalid() > 0 && (*it)->get_pages_valid() == BLOCK_SIZE)
+		while (num_to_erase != 0 && (blockErase = select_victim()) != NULL)
 		{
-			if (current_writing_block != (*it)->physical_address)
-			{
-				//printf("erase p: %p phy: %li ratio: %i num: %i\n", (*it), (*it)->physical_address, (*it)->get_pages_invalid(), num_to_erase);
-				Block *blockErase = (*it);
+			//printf("erase p: %p phy: %li ratio: %i num: %i\n", blockErase, blockErase->physical_address, blockErase->get_pages_invalid(), num_to_erase);
 
-				// Let the FTL handle cleanup of the block.
-				ftl->cleanup_block(event, blockErase);
+			enum block_type type = blockErase->get_block_type();
 
-				// Create erase event and attach to current event queue.
-				Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
-				erase_event.set_address(Address(blockErase->get_physical_address(), BLOCK));
+			// Let the FTL handle cleanup of the block.
+			ftl->cleanup_block(event, blockErase);
 
-				// Execute erase
-				if (ftl->controller.issue(erase_event) == FAILURE) { assert(false);	}
+			// Create erase event and attach to current event queue.
+			Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time());
+			erase_event.set_address(Address(blockErase->get_physical_address(), BLOCK));
+			erase_event.set_cause(CAUSE_GC);
 
-				free_list.push_back(blockErase);
+			// Execute erase
+			if (ftl->controller.issue(erase_event) == FAILURE) { assert(false);	}
 
-				event.incr_time_taken(erase_event.get_time_taken());
+			free_list.push_back(blockErase);
 
-				ftl->controller.stats.numFTLErase++;
-			}
+			// The block is claimed, and counted, again when it leaves the free list
+			if (type == MAP)
+				map_active--;
+			else
+				data_active--;
 
-			it = active_cost.get<1>().end();
-			--it;
+			event.incr_time_taken(erase_event.get_time_taken());
 
-			if (current_writing_block == (*it)->physical_address)
-			 --it;
+			ftl->controller.stats.numFTLErase++;
 
 			num_to_erase--;
 		}
 	}
+
+	ftl->controller.stats.latency_end(event);
+}
+
+/*
+ * The block with the most invalid pages among those completely written.
+ * Blocks still being filled (the current data and translation blocks) are
+ * passed over, however many of their pages are already invalid.
+ */
+Block *Block_manager::select_victim()
+{
+	ActiveByCost::iterator it = active_cost.get<1>().end();
+
+	while (it != active_cost.get<1>().begin())
+	{
+		--it;
+
+		if ((*it)->get_pages_invalid() == 0)
+			break;
+
+		if ((*it)->get_pages_valid() == BLOCK_SIZE && current_writing_block != (*it)->physical_address)
+			return *it;
+	}
+
+	return NULL;
 }
 
 Address Block_manager::get_free_block(block_type type, Event &event)
 {
 	Address address;
 	get_page_block(address, event);
+	claim_block(address, type);
+
+	return address;
+}
+
+/*
+ * Returns a free block of the given die, garbage collecting the die first
+ * when it is down to its last free block. The last block is kept for the
+ * copies GC makes itself.
+ */
+Address Block_manager::get_free_block(block_type type, Event &event, uint die)
+{
+	assert(die < die_free_list.size());
+
+	if (die_free_list[die].size() <= 1 && !die_collecting)
+		collect_die(event, die);
+
+	Address address;
+	address.set_linear_address(take_die_block(die), BLOCK);
+	claim_block(address, type);
+
+	return address;
+}
+
+void Block_manager::claim_block(Address &address, block_type type)
+{
 	switch (type)
 	{
 	case DATA:
@@ -259,13 +335,96 @@ Address Block_manager::get_free_block(block_type type, Event &event)
 		ftl->controller.get_block_pointer(address)->set_block_type(LOG);
 		log_active++;
 		break;
+	case MAP:
+		ftl->controller.get_block_pointer(address)->set_block_type(MAP);
+		map_active++;
+		break;
 	default:
 		break;
 	}
+}
+
+/*
+ * Takes the oldest free block of the die. A die that has run dry borrows
+ * from the die with the most free blocks; only a completely full device
+ * fails.
+ */
+ulong Block_manager::take_die_block(uint die)
+{
+	if (die_free_list[die].empty())
+	{
+		for (uint i = 0; i < die_free_list.size(); i++)
+			if (die_free_list[i].size() > die_free_list[die].size())
+				die = i;
+	}
+
+	assert(!die_free_list[die].empty());
+
+	ulong address = die_free_list[die].front();
+	die_free_list[die].pop_front();
+	die_free_blocks--;
 
 	return address;
 }
 
+/*
+ * Greedy victim selection: the completely written block of the die with the
+ * most invalid pages. Blocks still being written are never full, so the
+ * write points of the die are left alone.
+ */
+Block *Block_manager::select_die_victim(uint die)
+{
+	ulong blocksPerDie = DIE_SIZE * PLANE_SIZE;
+	Block *victim = NULL;
+
+	for (ulong i = die * blocksPerDie; i < (die + 1) * blocksPerDie; i++)
+	{
+		Block *b = active_cost[i];
+
+		if (b->get_pages_valid() == BLOCK_SIZE && b->get_pages_invalid() > 0
+				&& (victim == NULL || b->get_pages_invalid() > victim->get_pages_invalid()))
+			victim = b;
+	}
+
+	return victim;
+}
+
+/*
+ * Reclaims blocks of the die until it has a spare free block again. The FTL
+ * copies the valid pages of each victim (see cleanup_block), which may take
+ * the last free block; allocations made meanwhile do not collect again.
+ */
+void Block_manager::collect_die(Event &event, uint die)
+{
+	uint rounds = DIE_SIZE * PLANE_SIZE;
+	Block *victim;
+
+	ftl->controller.stats.latency_begin(LATENCY_GC, event);
+	die_collecting = true;
+
+	while (die_free_list[die].size() <= 1 && rounds-- > 0 && (victim = select_die_victim(die)) != NULL)
+	{
+		ftl->cleanup_block(event, victim);
+
+		Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time() + event.get_time_taken());
+		erase_event.set_address(Address(victim->get_physical_address(), BLOCK));
+		erase_event.set_cause(CAUSE_GC);
+
+		if (ftl->controller.issue(erase_event) == FAILURE) { assert(false); }
+
+		die_free_list[die].push_back(victim->get_physical_address());
+		die_free_blocks++;
+		data_active--;
+
+		event.incr_time_taken(erase_event.get_time_taken());
+		ftl->controller.stats.numFTLErase++;
+		ftl->controller.stats.numGCErase++;
+	}
+
+	die_collecting = false;
+	ftl->controller.stats.latency_end(event);
+}
+
 void Block_manager::print_cost_status()
 {
 
@@ -289,10 +448,11 @@ void Block_manager::print_cost_status()
 	}
 }
 
-void Block_manager::erase_and_invalidate(Event &event, Address &address, block_type btype)
+void Block_manager::erase_and_invalidate(Event &event, Address &address, block_type btype, enum event_cause cause)
 {
 	Event erase_event = Event(ERASE, event.get_logical_address(), 1, event.get_start_time()+event.get_time_taken());
 	erase_event.set_address(address);
+	erase_event.set_cause(cause);
 
 	if (ftl->controller.issue(erase_event) == FAILURE) { assert(false);}
 
@@ -306,6 +466,9 @@ void Block_manager::erase_and_invalidate(Event &event, Address &address, block_t
 	case LOG:
 		log_active--;
 		break;
+	case MAP:
+		map_active--;
+		break;
 	case LOG_SEQ:
 		break;
 	}
@@ -316,14 +479,33 @@ void Block_manager::erase_and_invalidate(Event &event, Address &address, block_t
 
 int Block_manager::get_num_free_blocks()
 {
-	if (simpleCurrentFree < max_blocks*BLOCK_SIZE)
-		return (simpleCurrentFree / BLOCK_SIZE) + free_list.size();
+	if (!die_free_list.empty())
+		return die_free_blocks;
+	else if (simpleCurrentFree < max_blocks*BLOCK_SIZE)
+		return (max_blocks - simpleCurrentFree / BLOCK_SIZE) + free_list.size();
 	else
 		return free_list.size();
 }
 
+ulong Block_manager::get_num_log_blocks() const
+{
+	return log_active;
+}
+
 void Block_manager::update_block(Block * b)
 {
 	std::size_t pos = (b->physical_address / BLOCK_SIZE);
 	active_cost.replace(active_cost.begin()+pos, b);
 }
+
+/* flash traffic accounting, called by Page::_write and Block::_erase for
+ * every page program and block erase, noop ones included */
+void Block_manager::record_program(const Event &event)
+{
+	ftl->controller.stats.numFlashProgram[event.get_cause()]++;
+}
+
+void Block_manager::record_erase(const Event &event)
+{
+	ftl->controller.stats.numFlashErase[event.get_cause()]++;
+}
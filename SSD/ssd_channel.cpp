@@ -182,6 +182,8 @@ enum status Channel::lock(double start_time, double duration, Event &event)
 	if (lt.unlock_time > ready_at)
 		ready_at = lt.unlock_time;
 
+	usage.record(sched_time, duration, sched_time - start_time);
+
 	/* update event times for bus wait and time taken */
 	event.incr_bus_wait_time(sched_time - start_time);
 	event.incr_time_taken(sched_time - start_time + duration);
@@ -217,3 +219,13 @@ double Channel::ready_time(void)
 	return ready_at;
 }
 
+const Utilization &Channel::get_utilization(void) const
+{
+	return usage;
+}
+
+void Channel::reset_utilization(void)
+{
+	usage.reset();
+}
+
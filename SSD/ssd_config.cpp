@@ -135,17 +135,33 @@ uint MAP_DIRECTORY_SIZE = 0;
  */
 uint FTL_IMPLEMENTATION = 0;
 
+/*
+ * Blocks of every die the page FTL keeps out of its logical capacity, for
+ * its write points and GC (at least 3)
+ */
+uint PAGE_SPARE_BLOCKS = 3;
+
 /*
  * Limit of LOG pages (for use in BAST)
  */
 uint BAST_LOG_BLOCK_LIMIT = 100;
 
+/*
+ * Log block merged by BAST when it needs a new one (see bast_victim_policy)
+ */
+uint BAST_VICTIM_POLICY = 0;
+
 
 /*
  * Limit of LOG pages (for use in FAST)
  */
 uint FAST_LOG_BLOCK_LIMIT = 4;
 
+/*
+ * Number of sequential write (SW) log blocks, one per stream (for use in FAST)
+ */
+uint FAST_SEQUENTIAL_LOG_LIMIT = 1;
+
 /*
  * Number of pages allowed to be in DFTL Cached Mapping Table.
  * (Size equals CACHE_BLOCK_LIMIT * block size * page size)
@@ -153,6 +169,19 @@ uint FAST_LOG_BLOCK_LIMIT = 4;
  */
 uint CACHE_DFTL_LIMIT = 8;
 
+/*
+ * Number of pages of controller RAM for the learned FTL's mapping segments,
+ * and the error bound (in pages) of a segment's predictions.
+ */
+uint LEARNED_CACHE_LIMIT = 8;
+uint LEARNED_ERROR_BOUND = 4;
+
+/*
+ * Number of pages of the DFTL Cached Mapping Table that variable-granularity
+ * DFTL may hand over to chunk mappings (at most half of CACHE_DFTL_LIMIT).
+ */
+uint VDFTL_CHUNK_LIMIT = 4;
+
 /*
  * Parallelism mode.
  * 0 -> Normal
@@ -218,12 +247,24 @@ void load_entry(char *name, double value, uint line_number) {
 		MAP_DIRECTORY_SIZE = value;
 	else if (!strcmp(name, "FTL_IMPLEMENTATION"))
 		FTL_IMPLEMENTATION = value;
+	else if (!strcmp(name, "PAGE_SPARE_BLOCKS"))
+		PAGE_SPARE_BLOCKS = value;
 	else if (!strcmp(name, "BAST_LOG_BLOCK_LIMIT"))
 		BAST_LOG_BLOCK_LIMIT = value;
+	else if (!strcmp(name, "BAST_VICTIM_POLICY"))
+		BAST_VICTIM_POLICY = value;
 	else if (!strcmp(name, "FAST_LOG_BLOCK_LIMIT"))
 		FAST_LOG_BLOCK_LIMIT = value;
+	else if (!strcmp(name, "FAST_SEQUENTIAL_LOG_LIMIT"))
+		FAST_SEQUENTIAL_LOG_LIMIT = value;
 	else if (!strcmp(name, "CACHE_DFTL_LIMIT"))
 		CACHE_DFTL_LIMIT = value;
+	else if (!strcmp(name, "LEARNED_CACHE_LIMIT"))
+		LEARNED_CACHE_LIMIT = value;
+	else if (!strcmp(name, "LEARNED_ERROR_BOUND"))
+		LEARNED_ERROR_BOUND = value;
+	else if (!strcmp(name, "VDFTL_CHUNK_LIMIT"))
+		VDFTL_CHUNK_LIMIT = value;
 	else if (!strcmp(name, "PARALLELISM_MODE"))
 		PARALLELISM_MODE = value;
 	else if (!strcmp(name, "VIRTUAL_BLOCK_SIZE"))
@@ -58,6 +58,15 @@ Controller::Controller(Ssd &parent):
 	case 4:
 		ftl = new FtlImpl_BDftl(*this);
 		break;
+	case 5:
+		ftl = new FtlImpl_Tpftl(*this);
+		break;
+	case 6:
+		ftl = new FtlImpl_Learned(*this);
+		break;
+	case 7:
+		ftl = new FtlImpl_Vdftl(*this);
+		break;
 	}
 	return;
 }
@@ -96,38 +105,38 @@ enum status Controller::issue(Event &event_list)
 		else if(cur -> get_event_type() == READ)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
-				|| ssd.read(*cur) == FAILURE
-				|| ssd.bus.lock(cur -> get_address().package, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
-				|| ssd.ram.write(*cur) == FAILURE
-				|| ssd.ram.read(*cur) == FAILURE
+			if(lock_bus(*cur, cur -> get_start_time(), BUS_CTRL_DELAY, "command") == FAILURE
+				|| flash(*cur) == FAILURE
+				|| lock_bus(*cur, cur -> get_start_time()+cur -> get_time_taken(), BUS_CTRL_DELAY + BUS_DATA_DELAY, "data out") == FAILURE
+				|| buffer(*cur) == FAILURE
 				|| ssd.replace(*cur) == FAILURE)
 				return FAILURE;
 		}
 		else if(cur -> get_event_type() == WRITE)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY + BUS_DATA_DELAY, *cur) == FAILURE
-				|| ssd.ram.write(*cur) == FAILURE
-				|| ssd.ram.read(*cur) == FAILURE
-				|| ssd.write(*cur) == FAILURE
+			if(lock_bus(*cur, cur -> get_start_time(), BUS_CTRL_DELAY + BUS_DATA_DELAY, "data in") == FAILURE
+				|| buffer(*cur) == FAILURE
+				|| flash(*cur) == FAILURE
 				|| ssd.replace(*cur) == FAILURE)
 				return FAILURE;
 		}
 		else if(cur -> get_event_type() == ERASE)
 		{
 			assert(cur -> get_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
-				|| ssd.erase(*cur) == FAILURE)
+			if(lock_bus(*cur, cur -> get_start_time(), BUS_CTRL_DELAY, "command") == FAILURE
+				|| flash(*cur) == FAILURE)
 				return FAILURE;
+			stats.eraseLatency.record(cur -> get_time_taken());
 		}
 		else if(cur -> get_event_type() == MERGE)
 		{
 			assert(cur -> get_address().valid > NONE);
 			assert(cur -> get_merge_address().valid > NONE);
-			if(ssd.bus.lock(cur -> get_address().package, cur -> get_start_time(), BUS_CTRL_DELAY, *cur) == FAILURE
-				|| ssd.merge(*cur) == FAILURE)
+			if(lock_bus(*cur, cur -> get_start_time(), BUS_CTRL_DELAY, "command") == FAILURE
+				|| flash(*cur) == FAILURE)
 				return FAILURE;
+			stats.mergeLatency.record(cur -> get_time_taken());
 		}
 		else if(cur -> get_event_type() == TRIM)
 		{
@@ -142,6 +151,66 @@ enum status Controller::issue(Event &event_list)
 	return SUCCESS;
 }
 
+/* the three stages of an issued event: its channel reservation, the flash
+ * operation on its die and its pass through the RAM buffer, each handed to
+ * the tracer when one is attached */
+enum status Controller::lock_bus(Event &event, double start_time, double duration, const char *name)
+{
+	double wait = event.get_bus_wait_time();
+
+	if (ssd.bus.lock(event.get_address().package, start_time, duration, event) == FAILURE)
+		return FAILURE;
+
+	if (ssd.tracer != NULL)
+	{
+		wait = event.get_bus_wait_time() - wait;
+		ssd.tracer -> channel(event, name, start_time + wait, duration, wait);
+	}
+	return SUCCESS;
+}
+
+enum status Controller::flash(Event &event)
+{
+	double time_before = event.get_time_taken();
+	enum status status;
+
+	switch (event.get_event_type())
+	{
+	case READ:
+		status = ssd.read(event);
+		break;
+	case WRITE:
+		status = ssd.write(event);
+		break;
+	case ERASE:
+		status = ssd.erase(event);
+		break;
+	case MERGE:
+		status = ssd.merge(event);
+		break;
+	default:
+		return FAILURE;
+	}
+
+	if (status == SUCCESS && event.get_cause() == CAUSE_HOST)
+		stats.latency_flash(event.get_time_taken() - time_before);
+	if (status == SUCCESS && ssd.tracer != NULL)
+		ssd.tracer -> flash(event, event.get_start_time() + time_before, event.get_time_taken() - time_before);
+	return status;
+}
+
+enum status Controller::buffer(Event &event)
+{
+	double time_before = event.get_time_taken();
+
+	if (ssd.ram.write(event) == FAILURE || ssd.ram.read(event) == FAILURE)
+		return FAILURE;
+
+	if (ssd.tracer != NULL)
+		ssd.tracer -> ram(event, event.get_start_time() + time_before, event.get_time_taken() - time_before);
+	return SUCCESS;
+}
+
 void Controller::translate_address(Address &address)
 {
 	if (PARALLELISM_MODE != 1)
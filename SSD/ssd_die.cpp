@@ -92,14 +92,20 @@ enum status Die::read(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
-	return data[event.get_address().plane].read(event);
+	double time_before = event.get_time_taken();
+	enum status status = data[event.get_address().plane].read(event);
+	usage.record_event(event, time_before);
+	return status;
 }
 
 enum status Die::write(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
-	return data[event.get_address().plane].write(event);
+	double time_before = event.get_time_taken();
+	enum status status = data[event.get_address().plane].write(event);
+	usage.record_event(event, time_before);
+	return status;
 }
 
 enum status Die::replace(Event &event)
@@ -117,7 +123,9 @@ enum status Die::erase(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE);
+	double time_before = event.get_time_taken();
 	enum status status = data[event.get_address().plane].erase(event);
+	usage.record_event(event, time_before);
 
 	/* update values if no errors */
 	if(status == SUCCESS)
@@ -131,9 +139,14 @@ enum status Die::merge(Event &event)
 {
 	assert(data != NULL);
 	assert(event.get_address().plane < size && event.get_address().valid > DIE && event.get_merge_address().plane < size && event.get_merge_address().valid > DIE);
+	double time_before = event.get_time_taken();
+	enum status status;
 	if(event.get_address().plane != event.get_merge_address().plane)
-		return _merge(event);
-	else return data[event.get_address().plane]._merge(event);
+		status = _merge(event);
+	else
+		status = data[event.get_address().plane]._merge(event);
+	usage.record_event(event, time_before);
+	return status;
 }
 
 /* TODO: update stub as per Die::merge() comment above
@@ -243,3 +256,21 @@ Block *Die::get_block_pointer(const Address & address)
 	assert(address.valid >= PLANE);
 	return data[address.plane].get_block_pointer(address);
 }
+
+/* if given a valid Plane address, return the Plane's utilization
+ * else return the Die's own */
+const Utilization &Die::get_utilization(const Address &address) const
+{
+	assert(data != NULL);
+	if(address.valid > DIE && address.plane < size)
+		return data[address.plane].get_utilization(address);
+	else
+		return usage;
+}
+
+void Die::reset_utilization(void)
+{
+	usage.reset();
+	for(uint i = 0; i < size; i++)
+		data[i].reset_utilization();
+}
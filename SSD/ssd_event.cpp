@@ -41,7 +41,9 @@ Event::Event(enum event_type type, ulong logical_address, uint size, double star
 	size(size),
 	payload(NULL),
 	next(NULL),
-	noop(false)
+	noop(false),
+	cause(CAUSE_HOST),
+	request_pages(1)
 {
 	assert(start_time >= 0.0);
 	return;
@@ -152,6 +154,18 @@ bool Event::get_noop(void) const
 	return noop;
 }
 
+enum event_cause Event::get_cause(void) const
+{
+	return cause;
+}
+
+/* pages of the host request from this event's page on, this one included;
+ * 1 for single-page requests and internal events */
+uint Event::get_request_pages(void) const
+{
+	return request_pages;
+}
+
 Event *Event::get_next(void) const
 {
 	return next;
@@ -189,6 +203,17 @@ void Event::set_noop(bool value)
 	noop = value;
 }
 
+void Event::set_cause(enum event_cause cause)
+{
+	this -> cause = cause;
+}
+
+void Event::set_request_pages(uint pages)
+{
+	assert(pages > 0);
+	request_pages = pages;
+}
+
 void Event::set_next(Event &next)
 {
 	this -> next = &next;
@@ -73,3 +73,17 @@ void FtlParent::print_ftl_statistics()
 {
 	return;
 }
+
+/* number of mapping entries held in the FTL's mapping cache
+ * only FTLs that cache mappings (DFTL and its relatives) have any */
+long FtlParent::get_num_cached_mappings() const
+{
+	return 0;
+}
+
+/* number of logical pages the FTL exports, all of the device unless it
+ * keeps spare blocks out of the logical space */
+ssd::ulong FtlParent::get_logical_pages() const
+{
+	return (ulong) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE;
+}
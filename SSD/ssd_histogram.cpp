@@ -0,0 +1,145 @@
+/* ssd_histogram.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Histogram class
+ *
+ * Log-linear latency histogram used by Stats to keep latency distributions
+ * at constant memory.  Bucket i below 2^HISTOGRAM_SUB_BITS holds exactly the
+ * value i; above that, every power of two is split into 2^HISTOGRAM_SUB_BITS
+ * equal buckets. */
+
+#include <assert.h>
+#include <stdio.h>
+#include <algorithm>
+#include "ssd.h"
+
+using namespace ssd;
+
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_NUM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+Histogram::Histogram(double resolution):
+	resolution(resolution),
+	counts(HISTOGRAM_NUM_BUCKETS, 0),
+	count(0),
+	sum(0.0),
+	max_value(0)
+{
+	assert(resolution > 0.0);
+}
+
+uint Histogram::index_of(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB_COUNT)
+		return value;
+
+	uint msb = 63 - __builtin_clzll(value);
+	uint shift = msb - HISTOGRAM_SUB_BITS;
+	return (shift + 1) * HISTOGRAM_SUB_COUNT + (uint) ((value >> shift) - HISTOGRAM_SUB_COUNT);
+}
+
+/* highest value that falls into the given bucket */
+uint64_t Histogram::value_of(uint index)
+{
+	if (index < HISTOGRAM_SUB_COUNT)
+		return index;
+
+	uint shift = index / HISTOGRAM_SUB_COUNT - 1;
+	uint64_t sub = index % HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_COUNT;
+	return (sub << shift) + ((1ULL << shift) - 1);
+}
+
+void Histogram::record(double value)
+{
+	if (value < 0.0)
+		value = 0.0;
+
+	uint64_t units = (uint64_t) (value / resolution + 0.5);
+	counts[index_of(units)]++;
+	count++;
+	sum += value;
+	if (units > max_value)
+		max_value = units;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+	assert(resolution == other.resolution);
+
+	for (uint i = 0; i < HISTOGRAM_NUM_BUCKETS; i++)
+		counts[i] += other.counts[i];
+	count += other.count;
+	sum += other.sum;
+	if (other.max_value > max_value)
+		max_value = other.max_value;
+}
+
+void Histogram::reset(void)
+{
+	std::fill(counts.begin(), counts.end(), 0);
+	count = 0;
+	sum = 0.0;
+	max_value = 0;
+}
+
+/* value at the given percentile (0 - 100], reported as the upper bound of
+ * the bucket holding it */
+double Histogram::percentile(double pct) const
+{
+	ulong rank, seen = 0;
+
+	if (count == 0)
+		return 0.0;
+
+	rank = (ulong) ((pct / 100.0) * count + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	for (uint i = 0; i < HISTOGRAM_NUM_BUCKETS; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+			return std::min(value_of(i), max_value) * resolution;
+	}
+	return max_value * resolution;
+}
+
+double Histogram::get_mean(void) const
+{
+	return (count == 0) ? 0.0 : sum / count;
+}
+
+double Histogram::get_max(void) const
+{
+	return max_value * resolution;
+}
+
+double Histogram::get_sum(void) const
+{
+	return sum;
+}
+
+ulong Histogram::get_count(void) const
+{
+	return count;
+}
+
+void Histogram::print(const char *name, FILE *stream) const
+{
+	fprintf(stream, "%-8s %10lu %12.6f %12.6f %12.6f %12.6f %12.6f\n", name, count,
+			get_mean(), percentile(50.0), percentile(99.0), percentile(99.9), get_max());
+}
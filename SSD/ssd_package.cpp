@@ -209,3 +209,17 @@ Block *Package::get_block_pointer(const Address & address)
 	assert(address.valid >= DIE);
 	return data[address.die].get_block_pointer(address);
 }
+
+/* packages are not hardware that can be busy: a valid Die address is
+ * required, and the Die (or Plane, see Die) utilization is returned */
+const Utilization &Package::get_utilization(const Address &address) const
+{
+	assert(data != NULL && address.valid > PACKAGE && address.die < size);
+	return data[address.die].get_utilization(address);
+}
+
+void Package::reset_utilization(void)
+{
+	for(uint i = 0; i < size; i++)
+		data[i].reset_utilization();
+}
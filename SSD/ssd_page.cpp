@@ -93,6 +93,8 @@ enum status Page::_write(Event &event)
 		state = VALID;
 	}
 
+	Block_manager::instance() -> record_program(event);
+
 	return SUCCESS;
 }
 
@@ -113,7 +113,10 @@ Plane::~Plane(void)
 enum status Plane::read(Event &event)
 {
 	assert(event.get_address().block < size && event.get_address().valid > PLANE);
-	return data[event.get_address().block].read(event);
+	double time_before = event.get_time_taken();
+	enum status status = data[event.get_address().block].read(event);
+	usage.record_event(event, time_before);
+	return status;
 }
 
 enum status Plane::write(Event &event)
@@ -122,7 +125,9 @@ enum status Plane::write(Event &event)
 
 	enum block_state prev = data[event.get_address().block].get_state();
 
+	double time_before = event.get_time_taken();
 	status s = data[event.get_address().block].write(event);
+	usage.record_event(event, time_before);
 
 	if(event.get_address().block == next_page.block)
 		/* if all blocks in the plane are full and this function fails,
@@ -149,7 +154,9 @@ enum status Plane::replace(Event &event)
 enum status Plane::erase(Event &event)
 {
 	assert(event.get_address().block < size && event.get_address().valid > PLANE);
+	double time_before = event.get_time_taken();
 	enum status status = data[event.get_address().block]._erase(event);
+	usage.record_event(event, time_before);
 
 	/* update values if no errors */
 	if(status == 1)
@@ -215,6 +222,8 @@ enum status Plane::_merge(Event &event)
 	Event write_event(WRITE, 0, 1, event.get_start_time());
 	read_event.set_address(read);
 	write_event.set_address(write);
+	read_event.set_cause(event.get_cause());
+	write_event.set_cause(event.get_cause());
 	
 	/* calculate merge delay and add to event time
 	 * use i as an error counter */
@@ -258,7 +267,9 @@ enum status Plane::_merge(Event &event)
 		}
 	}
 	total_delay += read_event.get_time_taken() + write_event.get_time_taken();
+	double time_before = event.get_time_taken();
 	event.incr_time_taken(total_delay);
+	usage.record_event(event, time_before);
 
 	/* update next_page for the get_free_page method if we used the page */
 	if(next_page.valid < PAGE)
@@ -403,3 +414,13 @@ Block *Plane::get_block_pointer(const Address & address)
 	assert(address.valid >= PLANE);
 	return data[address.block].get_pointer();
 }
+
+const Utilization &Plane::get_utilization(const Address &address) const
+{
+	return usage;
+}
+
+void Plane::reset_utilization(void)
+{
+	usage.reset();
+}
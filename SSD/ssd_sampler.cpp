@@ -0,0 +1,211 @@
+/* ssd_sampler.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Sampler class
+ *
+ * Time series of internal device state.  Averaged end-of-run statistics
+ * hide the moment the free pool runs dry and GC storms start; one row per
+ * interval shows them.  Host requests are accounted to the interval they
+ * arrive in.  Flash writes and erases are the page programs and block erases
+ * Stats counts at the flash, so write amplification is flash writes over
+ * host pages written. */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+static const char *sample_columns[] = {
+	"time", "requests", "readPages", "writePages", "trimPages", "meanLatency",
+	"freeBlocks", "logBlocks", "cachedMappings", "flashWrites", "erases",
+	"intervalWAF", "totalWAF"
+};
+
+#define SAMPLE_NUM_COLUMNS (sizeof(sample_columns) / sizeof(sample_columns[0]))
+
+Sampler::Sampler(Ssd &ssd, const char *path, enum sample_format format):
+	ssd(ssd),
+	format(format),
+	interval_time(0.0),
+	interval_requests(0),
+	started(false),
+	next_time(0.0),
+	last_time(0.0),
+	num_samples(0),
+	requests(0),
+	total_latency(0.0),
+	host_writes(0)
+{
+	if ((file = fopen(path, format == SAMPLE_BINARY ? "wb" : "w")) == NULL)
+	{
+		fprintf(stderr, "Sampler error: %s: could not open %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	for (uint i = 0; i <= TRIM; i++)
+		pages[i] = 0;
+
+	first_flash_writes = last_flash_writes = ssd.get_controller().stats.flash_programs();
+	last_erases = ssd.get_controller().stats.flash_erases();
+
+	write_header();
+	ssd.set_sampler(this);
+}
+
+Sampler::~Sampler(void)
+{
+	flush();
+	ssd.set_sampler(NULL);
+	fclose(file);
+}
+
+/* sample every time simulated time units, starting from the arrival of the
+ * first request */
+void Sampler::set_interval_time(double time)
+{
+	assert(time > 0.0);
+	interval_time = time;
+	interval_requests = 0;
+}
+
+/* sample after every requests finished host requests */
+void Sampler::set_interval_requests(ulong requests)
+{
+	assert(requests > 0);
+	interval_requests = requests;
+	interval_time = 0.0;
+}
+
+void Sampler::request_done(enum event_type type, uint size, double start_time, double time_taken)
+{
+	if (!started)
+	{
+		started = true;
+		last_time = start_time;
+		next_time = start_time + interval_time;
+	}
+
+	/* close every time interval that ended before this arrival */
+	if (interval_time > 0.0)
+		while (start_time >= next_time)
+		{
+			sample(next_time);
+			next_time += interval_time;
+		}
+
+	requests++;
+	if (type <= TRIM)
+		pages[type] += size;
+	if (type == WRITE)
+		host_writes += size;
+	total_latency += time_taken;
+
+	if (interval_requests > 0 && requests >= interval_requests)
+		sample(start_time);
+}
+
+/* write out the partial interval, if it has any requests */
+void Sampler::flush(void)
+{
+	if (requests > 0 && interval_time > 0.0)
+	{
+		sample(next_time);
+		next_time += interval_time;
+	}
+	else if (requests > 0)
+		sample(last_time);
+	fflush(file);
+}
+
+ulong Sampler::get_num_samples(void) const
+{
+	return num_samples;
+}
+
+void Sampler::write_header(void)
+{
+	if (format == SAMPLE_BINARY)
+	{
+		uint32_t version = SAMPLE_BINARY_VERSION;
+		uint32_t columns = SAMPLE_NUM_COLUMNS;
+		fwrite(SAMPLE_BINARY_MAGIC, 1, 4, file);
+		fwrite(&version, sizeof(version), 1, file);
+		fwrite(&columns, sizeof(columns), 1, file);
+		for (uint i = 0; i < SAMPLE_NUM_COLUMNS; i++)
+			fwrite(sample_columns[i], 1, strlen(sample_columns[i]) + 1, file);
+	}
+	else
+	{
+		for (uint i = 0; i < SAMPLE_NUM_COLUMNS; i++)
+			fprintf(file, "%s%s", sample_columns[i], i + 1 < SAMPLE_NUM_COLUMNS ? ";" : "\n");
+	}
+}
+
+void Sampler::sample(double time)
+{
+	const Stats &stats = ssd.get_controller().stats;
+	const FtlParent &ftl = ssd.get_controller().get_ftl();
+
+	/* statistics were reset under us: restart the deltas from zero */
+	if (stats.flash_programs() < last_flash_writes || stats.flash_erases() < last_erases)
+	{
+		first_flash_writes = last_flash_writes = 0;
+		last_erases = 0;
+		host_writes = pages[WRITE];
+	}
+
+	long flash_writes = stats.flash_programs() - last_flash_writes;
+	long erases = stats.flash_erases() - last_erases;
+
+	double row[SAMPLE_NUM_COLUMNS] = {
+		time,
+		(double) requests,
+		(double) pages[READ],
+		(double) pages[WRITE],
+		(double) pages[TRIM],
+		requests > 0 ? total_latency / requests : 0.0,
+		(double) Block_manager::instance() -> get_num_free_blocks(),
+		(double) Block_manager::instance() -> get_num_log_blocks(),
+		(double) ftl.get_num_cached_mappings(),
+		(double) flash_writes,
+		(double) erases,
+		pages[WRITE] > 0 ? (double) flash_writes / pages[WRITE] : 0.0,
+		host_writes > 0 ? (double) (stats.flash_programs() - first_flash_writes) / host_writes : 0.0
+	};
+
+	if (format == SAMPLE_BINARY)
+		fwrite(row, sizeof(double), SAMPLE_NUM_COLUMNS, file);
+	else
+	{
+		fprintf(file, "%f", row[0]);
+		for (uint i = 1; i < SAMPLE_NUM_COLUMNS; i++)
+			fprintf(file, ";%.10g", row[i]);
+		fprintf(file, "\n");
+	}
+
+	num_samples++;
+	last_time = time;
+	last_flash_writes = stats.flash_programs();
+	last_erases = stats.flash_erases();
+	requests = 0;
+	for (uint i = 0; i <= TRIM; i++)
+		pages[i] = 0;
+	total_latency = 0.0;
+}
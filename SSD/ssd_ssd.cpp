@@ -35,6 +35,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <limits.h>
+#include <string.h>
 
 using namespace ssd;
 
@@ -60,7 +61,15 @@ Ssd::Ssd(uint ssd_size):
 	least_worn(0), 
 
 	/* assume hardware created at time 0 and had an implied free erasure */
-	last_erase_time(0.0)
+	last_erase_time(0.0),
+
+	/* grown on demand by multi-page reads */
+	result_buffer(NULL),
+	result_buffer_pages(0),
+
+	/* time-series sampling is off until a Sampler attaches itself */
+	sampler(NULL),
+	tracer(NULL)
 {
 	uint i;
 
@@ -125,6 +134,7 @@ Ssd::~Ssd(void)
 		data[i].~Package();
 	}
 	free(data);
+	free(result_buffer);
 	ulong pageSize = ((ulong)(SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE)) * (ulong)PAGE_SIZE;
 	munmap(page_data, pageSize);
 
@@ -141,8 +151,92 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
  * 	logical_address (page number), size of request in pages, and the start
  * 	time (arrive time) of the request
  * The SSD will process the request and return the time taken to process the
- * 	request.  Remember to use the same time units as in the config file. */
+ * 	request.  Remember to use the same time units as in the config file.
+ *
+ * The controller only handles single-page events, so a request larger than
+ * 	one page is split into one event per page, all arriving at start_time.
+ * 	The request is done when its slowest page is.  For multi-page reads with
+ * 	data enabled, the pages are gathered into one contiguous result buffer. */
 double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size, double start_time, void *buffer)
+{
+	double time_taken = 0.0;
+
+	controller.stats.latency_request_begin();
+	if (tracer != NULL)
+		tracer -> request_begin();
+
+	if (size <= 1)
+	{
+		time_taken = event_arrive_page(type, logical_address, 1, start_time, buffer);
+		request_done(type, logical_address, size, start_time, time_taken);
+		return time_taken;
+	}
+
+	if (type == READ && PAGE_ENABLE_DATA && size > result_buffer_pages)
+	{
+		if((result_buffer = realloc(result_buffer, (size_t) size * PAGE_SIZE)) == NULL)
+		{
+			fprintf(stderr, "Ssd error: %s: could not allocate result buffer\n", __func__);
+			exit(MEM_ERR);
+		}
+		result_buffer_pages = size;
+	}
+
+	for (uint i = 0; i < size; i++)
+	{
+		void *page_buffer = (buffer == NULL) ? NULL : (char *) buffer + (size_t) i * PAGE_SIZE;
+		double page_time = event_arrive_page(type, logical_address + i, size - i, start_time, page_buffer);
+
+		if (page_time > time_taken)
+			time_taken = page_time;
+
+		if (type == READ && PAGE_ENABLE_DATA)
+		{
+			void *dest = (char *) result_buffer + (size_t) i * PAGE_SIZE;
+			if (global_buffer != NULL && global_buffer != result_buffer)
+				memcpy(dest, global_buffer, PAGE_SIZE);
+			else
+				memset(dest, 0, PAGE_SIZE);
+		}
+	}
+
+	if (type == READ && PAGE_ENABLE_DATA)
+		global_buffer = result_buffer;
+
+	request_done(type, logical_address, size, start_time, time_taken);
+	return time_taken;
+}
+
+/* account a finished host request: add its response time and its
+ * attribution to the latency histograms of its type, count the host pages
+ * written and pass it on to the sampler and tracer, if any */
+void Ssd::request_done(enum event_type type, ulong logical_address, uint size, double start_time, double time_taken)
+{
+	if (sampler != NULL)
+		sampler -> request_done(type, size, start_time, time_taken);
+	if (tracer != NULL)
+		tracer -> request_end(type, logical_address, size, start_time, time_taken);
+
+	controller.stats.latency_request_end(type, time_taken);
+
+	switch (type)
+	{
+	case READ:
+		controller.stats.readLatency.record(time_taken);
+		break;
+	case WRITE:
+		controller.stats.writeLatency.record(time_taken);
+		controller.stats.numHostWrite += size;
+		break;
+	case TRIM:
+		controller.stats.trimLatency.record(time_taken);
+		break;
+	default:
+		break;
+	}
+}
+
+double Ssd::event_arrive_page(enum event_type type, ulong logical_address, uint request_pages, double start_time, void *buffer)
 {
 	assert(start_time >= 0.0);
 
@@ -155,19 +249,22 @@ double Ssd::event_arrive(enum event_type type, ulong logical_address, uint size,
 	 * handle efficiency issues for us */
 	Event *event = NULL;
 
-	if((event = new Event(type, logical_address , size, start_time)) == NULL)
+	if((event = new Event(type, logical_address , 1, start_time)) == NULL)
 	{
 		fprintf(stderr, "Ssd error: %s: could not allocate Event\n", __func__);
 		exit(MEM_ERR);
 	}
 
 	event->set_payload(buffer);
+	event->set_request_pages(request_pages);
 
+	controller.stats.latency_page_begin();
 	if(controller.event_arrive(*event) != SUCCESS)
 	{
 		fprintf(stderr, "Ssd error: %s: request failed:\n", __func__);
 		event -> print(stderr);
 	}
+	controller.stats.latency_page_end(*event);
 
 	/* use start_time as a temporary for returning time taken to service event */
 	start_time = event -> get_time_taken();
@@ -322,16 +419,148 @@ ssd::uint Ssd::get_num_invalid(const Address &address) const
 void Ssd::print_statistics()
 {
 	controller.stats.print_statistics();
+
+	double span = utilization_span();
+	const char *names[] = {"Channels", "Dies", "Planes"};
+	enum address_valid levels[] = {PACKAGE, DIE, PLANE};
+
+	printf("Utilization over %f:\n", span);
+	for (uint i = 0; i < 3; i++)
+	{
+		double mean, min, max, queue;
+		utilization_summary(levels[i], span, mean, min, max, queue);
+		printf("%-8s mean: %6.2f%%  min: %6.2f%%  max: %6.2f%%  queue/op: %f\n", names[i], mean * 100, min * 100, max * 100, queue);
+	}
+	printf("-----------\n");
 }
 
 void Ssd::reset_statistics()
 {
 	controller.stats.reset_statistics();
+	reset_utilization();
 }
 
 void Ssd::write_statistics(FILE *stream)
 {
 	controller.stats.write_statistics(stream);
+
+	double span = utilization_span();
+	enum address_valid levels[] = {PACKAGE, DIE, PLANE};
+
+	fprintf(stream, "%f;", span);
+	for (uint i = 0; i < 3; i++)
+	{
+		double mean, min, max, queue;
+		utilization_summary(levels[i], span, mean, min, max, queue);
+		fprintf(stream, "%f;%f;%f;%f;", mean, min, max, queue);
+	}
+	fprintf(stream, "\n");
+}
+
+/* simulated time covered by the recorded operations, from the earliest start
+ * to the latest finish on any channel (every flash operation uses one) */
+double Ssd::utilization_span(void)
+{
+	double first = -1.0;
+	double last = 0.0;
+
+	for (uint i = 0; i < size; i++)
+	{
+		const Utilization &usage = bus.get_channel(i).get_utilization();
+		if (usage.get_ops() == 0)
+			continue;
+		if (first < 0.0 || usage.get_first_time() < first)
+			first = usage.get_first_time();
+		if (usage.get_last_time() > last)
+			last = usage.get_last_time();
+	}
+	return first < 0.0 ? 0.0 : last - first;
+}
+
+/* utilization of the channel of a package (address valid to PACKAGE), or of
+ * a die or plane */
+const Utilization &Ssd::get_utilization(const Address &address)
+{
+	assert(data != NULL && address.package < size && address.valid >= PACKAGE);
+	if (address.valid == PACKAGE)
+		return bus.get_channel(address.package).get_utilization();
+	return data[address.package].get_utilization(address);
+}
+
+/* mean, min and max utilization over all channels (level PACKAGE), dies or
+ * planes, and the mean queue time per operation */
+void Ssd::utilization_summary(enum address_valid level, double span, double &mean, double &min, double &max, double &queue)
+{
+	ulong count = 0;
+	ulong ops = 0;
+	double queue_time = 0.0;
+
+	mean = 0.0;
+	min = -1.0;
+	max = 0.0;
+
+	Address address(0, 0, 0, 0, 0, level);
+	for (address.package = 0; address.package < size; address.package++)
+		for (address.die = 0; address.die < (level > PACKAGE ? PACKAGE_SIZE : 1); address.die++)
+			for (address.plane = 0; address.plane < (level > DIE ? DIE_SIZE : 1); address.plane++)
+			{
+				const Utilization &usage = (level == PACKAGE) ? bus.get_channel(address.package).get_utilization() : data[address.package].get_utilization(address);
+				double utilization = usage.get_utilization(span);
+
+				mean += utilization;
+				if (min < 0.0 || utilization < min)
+					min = utilization;
+				if (utilization > max)
+					max = utilization;
+				ops += usage.get_ops();
+				queue_time += usage.get_queue_time();
+				count++;
+			}
+
+	mean = count > 0 ? mean / count : 0.0;
+	min = min < 0.0 ? 0.0 : min;
+	queue = ops > 0 ? queue_time / ops : 0.0;
+}
+
+/* per-resource utilization dump: one line per channel, die and plane */
+void Ssd::print_utilization(FILE *stream)
+{
+	double span = utilization_span();
+
+	fprintf(stream, "%-14s %10s %14s %14s %8s %14s %12s\n", "Resource", "ops", "busy", "idle", "util", "queue", "queue/op");
+	for (uint i = 0; i < size; i++)
+	{
+		const Utilization &usage = bus.get_channel(i).get_utilization();
+		fprintf(stream, "channel %-6u %10lu %14f %14f %7.2f%% %14f %12f\n", i, usage.get_ops(), usage.get_busy_time(), usage.get_idle_time(span),
+				usage.get_utilization(span) * 100, usage.get_queue_time(), usage.get_ops() > 0 ? usage.get_queue_time() / usage.get_ops() : 0.0);
+	}
+
+	Address address(0, 0, 0, 0, 0, DIE);
+	for (address.package = 0; address.package < size; address.package++)
+		for (address.die = 0; address.die < PACKAGE_SIZE; address.die++)
+			for (int plane = -1; plane < (int) DIE_SIZE; plane++)
+			{
+				char name[32];
+				address.plane = plane < 0 ? 0 : plane;
+				address.valid = plane < 0 ? DIE : PLANE;
+				if (plane < 0)
+					snprintf(name, sizeof(name), "die %u.%u", address.package, address.die);
+				else
+					snprintf(name, sizeof(name), "  plane %u.%u.%u", address.package, address.die, address.plane);
+
+				const Utilization &usage = data[address.package].get_utilization(address);
+				fprintf(stream, "%-14s %10lu %14f %14f %7.2f%% %14f %12f\n", name, usage.get_ops(), usage.get_busy_time(), usage.get_idle_time(span),
+						usage.get_utilization(span) * 100, usage.get_queue_time(), usage.get_ops() > 0 ? usage.get_queue_time() / usage.get_ops() : 0.0);
+			}
+}
+
+void Ssd::reset_utilization(void)
+{
+	for (uint i = 0; i < size; i++)
+	{
+		bus.get_channel(i).reset_utilization();
+		data[i].reset_utilization();
+	}
 }
 
 void Ssd::print_ftl_statistics()
@@ -342,6 +571,12 @@ void Ssd::print_ftl_statistics()
 void Ssd::write_header(FILE *stream)
 {
 	controller.stats.write_header(stream);
+
+	fprintf(stream, "utilizationSpan;");
+	const char *names[] = {"channel", "die", "plane"};
+	for (uint i = 0; i < 3; i++)
+		fprintf(stream, "%sUtilMean;%sUtilMin;%sUtilMax;%sQueuePerOp;", names[i], names[i], names[i], names[i]);
+	fprintf(stream, "\n");
 }
 
 Block *Ssd::get_block_pointer(const Address & address)
@@ -355,6 +590,20 @@ const Controller &Ssd::get_controller(void) const
 	return controller;
 }
 
+/* attach a sampler that is told about every finished host request
+ * pass NULL to detach */
+void Ssd::set_sampler(Sampler *sampler)
+{
+	this -> sampler = sampler;
+}
+
+/* attach a tracer that records every operation issued to the hardware
+ * pass NULL to detach */
+void Ssd::set_tracer(Tracer *tracer)
+{
+	this -> tracer = tracer;
+}
+
 /**
  * Returns the next ready time. The ready time is the latest point in time when one of the channels are ready to serve new requests.
  */
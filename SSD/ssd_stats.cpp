@@ -29,6 +29,9 @@
 
 using namespace ssd;
 
+static const char *cause_names[NUM_EVENT_CAUSES] = {"Host", "GC", "Merge", "Mapping", "WL"};
+static const char *part_names[NUM_LATENCY_PARTS] = {"BusWait", "Mapping", "GC", "Merge", "Flash", "Other"};
+
 Stats::Stats()
 {
 	reset();
@@ -70,6 +73,32 @@ void Stats::reset()
 
 	numMemoryRead = 0;
 	numMemoryWrite = 0;
+
+	// Host versus flash traffic
+	numHostWrite = 0;
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+	{
+		numFlashProgram[i] = 0;
+		numFlashErase[i] = 0;
+	}
+	intervalHostWrite = 0;
+	intervalFlashProgram = 0;
+
+	// Latency distributions
+	readLatency.reset();
+	writeLatency.reset();
+	trimLatency.reset();
+	eraseLatency.reset();
+	mergeLatency.reset();
+
+	// Latency attribution
+	for (uint i = 0; i < NUM_LATENCY_PARTS; i++)
+	{
+		readLatencyPart[i].reset();
+		writeLatencyPart[i].reset();
+	}
+	latency_request_begin();
+	latency_page_begin();
 }
 
 void Stats::reset_statistics()
@@ -77,14 +106,144 @@ void Stats::reset_statistics()
 	reset();
 }
 
+long Stats::flash_programs() const
+{
+	long total = 0;
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		total += numFlashProgram[i];
+	return total;
+}
+
+long Stats::flash_erases() const
+{
+	long total = 0;
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		total += numFlashErase[i];
+	return total;
+}
+
+/* flash pages programmed per host page written since the last reset */
+double Stats::write_amplification() const
+{
+	return numHostWrite > 0 ? (double) flash_programs() / numHostWrite : 0.0;
+}
+
+/* write amplification since the last mark_interval, i.e. since the previous
+ * row written by write_statistics */
+double Stats::interval_write_amplification() const
+{
+	long host = numHostWrite - intervalHostWrite;
+	return host > 0 ? (double) (flash_programs() - intervalFlashProgram) / host : 0.0;
+}
+
+void Stats::mark_interval()
+{
+	intervalHostWrite = numHostWrite;
+	intervalFlashProgram = flash_programs();
+}
+
+/* latency attribution
+ * The FTL brackets the work it does on behalf of a host page event with
+ * latency_begin and latency_end; the time the event gained in between is
+ * attributed to the part.  Nested brackets (a merge updating the map
+ * block, GC writing back mappings) count towards the outermost one.  The
+ * controller reports the flash time of host events outside any bracket,
+ * and the event's own bus wait is taken when the page is done.  A request
+ * of several pages is as slow as its slowest page, so that page's parts
+ * are recorded, with whatever they do not explain as other. */
+void Stats::latency_begin(enum latency_part part, const Event &event)
+{
+	if (latencyDepth++ == 0)
+	{
+		latencyPart = part;
+		latencyMark = event.get_time_taken();
+	}
+}
+
+void Stats::latency_end(const Event &event)
+{
+	assert(latencyDepth > 0);
+	if (--latencyDepth == 0)
+		pageLatency[latencyPart] += event.get_time_taken() - latencyMark;
+}
+
+void Stats::latency_flash(double time)
+{
+	if (latencyDepth == 0)
+		pageLatency[LATENCY_FLASH] += time;
+}
+
+void Stats::latency_page_begin()
+{
+	latencyDepth = 0;
+	for (uint i = 0; i < NUM_LATENCY_PARTS; i++)
+		pageLatency[i] = 0.0;
+}
+
+void Stats::latency_page_end(const Event &event)
+{
+	pageLatency[LATENCY_BUS_WAIT] = event.get_bus_wait_time();
+
+	if (event.get_time_taken() > requestPageTime)
+	{
+		requestPageTime = event.get_time_taken();
+		for (uint i = 0; i < NUM_LATENCY_PARTS; i++)
+			requestLatency[i] = pageLatency[i];
+	}
+}
+
+void Stats::latency_request_begin()
+{
+	requestPageTime = -1.0;
+	for (uint i = 0; i < NUM_LATENCY_PARTS; i++)
+		requestLatency[i] = 0.0;
+}
+
+void Stats::latency_request_end(enum event_type type, double time_taken)
+{
+	Histogram *parts;
+	double explained = 0.0;
+
+	if (type == READ)
+		parts = readLatencyPart;
+	else if (type == WRITE)
+		parts = writeLatencyPart;
+	else
+		return;
+
+	for (uint i = 0; i < LATENCY_OTHER; i++)
+	{
+		parts[i].record(requestLatency[i]);
+		explained += requestLatency[i];
+	}
+	parts[LATENCY_OTHER].record(time_taken > explained ? time_taken - explained : 0.0);
+}
+
+/* write_header and write_statistics leave the line open: Ssd appends its
+ * device-level columns and ends the row */
 void Stats::write_header(FILE *stream)
 {
-	fprintf(stream, "numFTLRead;numFTLWrite;numFTLErase;numFTLTrim;numGCRead;numGCWrite;numGCErase;numWLRead;numWLWrite;numWLErase;numLogMergeSwitch;numLogMergePartial;numLogMergeFull;numPageBlockToPageConversion;numCacheHits;numCacheFaults;numMemoryTranslation;numMemoryCache;numMemoryRead;numMemoryWrite\n");
+	fprintf(stream, "numFTLRead;numFTLWrite;numFTLErase;numFTLTrim;numGCRead;numGCWrite;numGCErase;numWLRead;numWLWrite;numWLErase;numLogMergeSwitch;numLogMergePartial;numLogMergeFull;numPageBlockToPageConversion;numCacheHits;numCacheFaults;numMemoryTranslation;numMemoryCache;numMemoryRead;numMemoryWrite;");
+
+	fprintf(stream, "numHostWrite;");
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		fprintf(stream, "numFlashProgram%s;", cause_names[i]);
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		fprintf(stream, "numFlashErase%s;", cause_names[i]);
+	fprintf(stream, "writeAmplification;intervalWriteAmplification;");
+
+	const char *ops[] = {"read", "write", "trim", "erase", "merge"};
+	for (uint i = 0; i < 5; i++)
+		fprintf(stream, "%sLatencyMean;%sLatencyP50;%sLatencyP99;%sLatencyP999;%sLatencyMax;", ops[i], ops[i], ops[i], ops[i], ops[i]);
+
+	for (uint i = 0; i < 2; i++)
+		for (uint j = 0; j < NUM_LATENCY_PARTS; j++)
+			fprintf(stream, "%sLatency%sTotal;%sLatency%sP99;", ops[i], part_names[j], ops[i], part_names[j]);
 }
 
 void Stats::write_statistics(FILE *stream)
 {
-	fprintf(stream, "%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;\n",
+	fprintf(stream, "%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;%li;",
 			numFTLRead, numFTLWrite, numFTLErase, numFTLTrim,
 			numGCRead, numGCWrite, numGCErase,
 			numWLRead, numWLWrite, numWLErase,
@@ -95,6 +254,24 @@ void Stats::write_statistics(FILE *stream)
 			numMemoryCache,
 			numMemoryRead,numMemoryWrite);
 
+	fprintf(stream, "%li;", numHostWrite);
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		fprintf(stream, "%li;", numFlashProgram[i]);
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		fprintf(stream, "%li;", numFlashErase[i]);
+	fprintf(stream, "%f;%f;", write_amplification(), interval_write_amplification());
+	mark_interval();
+
+	const Histogram *latencies[] = {&readLatency, &writeLatency, &trimLatency, &eraseLatency, &mergeLatency};
+	for (uint i = 0; i < 5; i++)
+		fprintf(stream, "%f;%f;%f;%f;%f;", latencies[i]->get_mean(), latencies[i]->percentile(50.0),
+				latencies[i]->percentile(99.0), latencies[i]->percentile(99.9), latencies[i]->get_max());
+
+	const Histogram *parts[] = {readLatencyPart, writeLatencyPart};
+	for (uint i = 0; i < 2; i++)
+		for (uint j = 0; j < NUM_LATENCY_PARTS; j++)
+			fprintf(stream, "%f;%f;", parts[i][j].get_sum(), parts[i][j].percentile(99.0));
+
 	//print_statistics();
 }
 
@@ -111,5 +288,29 @@ void Stats::print_statistics()
 	printf("Memory Consumption:\n");
 	printf("Tranlation: %li Cache: %li\n", numMemoryTranslation, numMemoryCache);
 	printf("Reads: %li \tWrites: %li\n", numMemoryRead, numMemoryWrite);
+	printf("Host Writes: %li Flash Programs: %li Erases: %li\n", numHostWrite, flash_programs(), flash_erases());
+	printf("%-8s", "Cause");
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		printf(" %10s", cause_names[i]);
+	printf("\n%-8s", "Programs");
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		printf(" %10li", numFlashProgram[i]);
+	printf("\n%-8s", "Erases");
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		printf(" %10li", numFlashErase[i]);
+	printf("\nWrite Amplification: %f Interval: %f\n", write_amplification(), interval_write_amplification());
+	printf("%-8s %10s %12s %12s %12s %12s %12s\n", "Latency", "count", "mean", "p50", "p99", "p99.9", "max");
+	readLatency.print("  Read");
+	writeLatency.print("  Write");
+	trimLatency.print("  Trim");
+	eraseLatency.print("  Erase");
+	mergeLatency.print("  Merge");
+	printf("%-10s %12s %7s %12s %14s %7s %12s\n", "Part", "read total", "share", "p99", "write total", "share", "p99");
+	for (uint i = 0; i < NUM_LATENCY_PARTS; i++)
+		printf("  %-8s %12.3f %6.1f%% %12.6f %14.3f %6.1f%% %12.6f\n", part_names[i],
+				readLatencyPart[i].get_sum(), readLatency.get_sum() > 0.0 ? 100.0 * readLatencyPart[i].get_sum() / readLatency.get_sum() : 0.0,
+				readLatencyPart[i].percentile(99.0),
+				writeLatencyPart[i].get_sum(), writeLatency.get_sum() > 0.0 ? 100.0 * writeLatencyPart[i].get_sum() / writeLatency.get_sum() : 0.0,
+				writeLatencyPart[i].percentile(99.0));
 	printf("-----------\n");
 }
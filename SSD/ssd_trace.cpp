@@ -0,0 +1,679 @@
+/* ssd_trace.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Trace replay
+ *
+ * TraceFile streams block traces in the common text formats out of a
+ * read-only mapping of the trace, BinaryTraceFile does the same for the
+ * compact binary format written by BinaryTraceWriter, and TraceReplayer
+ * feeds the requests to a Ssd, either honouring the trace timestamps (open
+ * loop) or keeping a fixed number of requests outstanding (closed loop).
+ */
+
+#include <new>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <queue>
+#include <functional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* Longest trace line handled; anything beyond is cut off. */
+static const size_t TRACE_LINE_MAX = 1024;
+
+/* Consumed parts of the mapping are handed back to the kernel in chunks of
+ * this many bytes. */
+static const size_t TRACE_RELEASE_CHUNK = 16 * 1024 * 1024;
+
+/* Sector size used by the SPC and blkparse formats. */
+static const ulong TRACE_SECTOR_SIZE = 512;
+
+/* Hand the part of a mapping before position back to the kernel once at
+ * least a release chunk of it has been consumed. */
+static void release_consumed(char *map, size_t position, size_t &released)
+{
+	if (position - released >= TRACE_RELEASE_CHUNK)
+	{
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t upto = (position / page) * page;
+		madvise(map + released, upto - released, MADV_DONTNEED);
+		released = upto;
+	}
+}
+
+TraceFile::TraceFile(const char *path, enum trace_format format):
+	format(format),
+	fd(-1),
+	map(NULL),
+	length(0),
+	position(0),
+	released(0),
+	fio_version(2),
+	fio_time(0.0)
+{
+	struct stat st;
+
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+	{
+		fprintf(stderr, "TraceFile error: %s: cannot open trace file %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	length = st.st_size;
+	if (length == 0)
+		return;
+
+	map = (char *) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		fprintf(stderr, "TraceFile error: %s: cannot map trace file %s\n", __func__, path);
+		exit(MEM_ERR);
+	}
+
+	madvise(map, length, MADV_SEQUENTIAL);
+}
+
+TraceFile::~TraceFile(void)
+{
+	if (map != NULL)
+		munmap(map, length);
+	if (fd >= 0)
+		close(fd);
+}
+
+bool TraceFile::next(TraceRecord &record)
+{
+	char line[TRACE_LINE_MAX];
+
+	while (position < length)
+	{
+		const char *start = map + position;
+		const char *end = (const char *) memchr(start, '\n', length - position);
+		size_t line_length = (end == NULL) ? length - position : (size_t) (end - start);
+
+		position += line_length + 1;
+
+		if (line_length >= TRACE_LINE_MAX)
+			line_length = TRACE_LINE_MAX - 1;
+		memcpy(line, start, line_length);
+		line[line_length] = '\0';
+
+		release_consumed(map, position, released);
+
+		record.time = 0.0;
+		record.stream = 0;
+		if (parse_line(line, record))
+			return true;
+	}
+	return false;
+}
+
+void TraceFile::rewind(void)
+{
+	position = 0;
+	released = 0;
+	fio_version = 2;
+	fio_time = 0.0;
+	if (map != NULL)
+		madvise(map, length, MADV_SEQUENTIAL);
+}
+
+bool TraceFile::parse_line(const char *line, TraceRecord &record)
+{
+	switch (format)
+	{
+	case TRACE_MSR:
+		return parse_msr(line, record);
+	case TRACE_SPC:
+		return parse_spc(line, record);
+	case TRACE_BLKPARSE:
+		return parse_blkparse(line, record);
+	case TRACE_FIO:
+		return parse_fio(line, record);
+	default:
+		return false;
+	}
+}
+
+/* Timestamp,Hostname,DiskNumber,Type,Offset,Size,ResponseTime
+ * The timestamp is a Windows filetime, in units of 100ns. */
+bool TraceFile::parse_msr(const char *line, TraceRecord &record)
+{
+	char *p;
+	unsigned long long filetime = strtoull(line, &p, 10);
+
+	if (p == line || *p != ',')
+		return false;
+	if ((p = strchr(p + 1, ',')) == NULL)
+		return false;
+	record.stream = strtoul(p + 1, &p, 10);
+	if (*p != ',')
+		return false;
+
+	p++;
+	if (strncasecmp(p, "Read", 4) == 0)
+		record.type = READ;
+	else if (strncasecmp(p, "Write", 5) == 0)
+		record.type = WRITE;
+	else
+		return false;
+
+	if ((p = strchr(p, ',')) == NULL)
+		return false;
+	record.offset = strtoull(p + 1, &p, 10);
+	if (*p != ',')
+		return false;
+	record.size = strtoul(p + 1, &p, 10);
+
+	record.time = filetime * 1e-7;
+	return true;
+}
+
+/* ASU,LBA,Size,Opcode,Timestamp
+ * LBAs are in sectors, sizes in bytes and timestamps in seconds. */
+bool TraceFile::parse_spc(const char *line, TraceRecord &record)
+{
+	char *p;
+
+	record.stream = strtoul(line, &p, 10);
+	if (p == line || *p != ',')
+		return false;
+	record.offset = strtoull(p + 1, &p, 10) * TRACE_SECTOR_SIZE;
+	if (*p != ',')
+		return false;
+	record.size = strtoul(p + 1, &p, 10);
+	if (*p != ',')
+		return false;
+
+	p++;
+	while (*p == ' ')
+		p++;
+	if (*p == 'r' || *p == 'R')
+		record.type = READ;
+	else if (*p == 'w' || *p == 'W')
+		record.type = WRITE;
+	else
+		return false;
+
+	if ((p = strchr(p, ',')) == NULL)
+		return false;
+	record.time = strtod(p + 1, NULL);
+	return true;
+}
+
+/* maj,min cpu seq time pid action rwbs sector + sectors [process]
+ * Only requests issued to the driver ('D') are replayed; a 'D' in the
+ * rwbs field marks a discard. */
+bool TraceFile::parse_blkparse(const char *line, TraceRecord &record)
+{
+	char action[16], rwbs[16];
+	unsigned long long sector;
+	uint sectors;
+
+	if (sscanf(line, "%*s %*s %*s %lf %*s %15s %15s %llu + %u", &record.time, action, rwbs, &sector, &sectors) != 5)
+		return false;
+	if (strcmp(action, "D") != 0 || sectors == 0)
+		return false;
+
+	if (strchr(rwbs, 'D') != NULL)
+		record.type = TRIM;
+	else if (strchr(rwbs, 'W') != NULL)
+		record.type = WRITE;
+	else if (strchr(rwbs, 'R') != NULL)
+		record.type = READ;
+	else
+		return false;
+
+	record.offset = sector * TRACE_SECTOR_SIZE;
+	record.size = sectors * TRACE_SECTOR_SIZE;
+	return true;
+}
+
+/* fio iolog
+ * 	version 2: filename action offset length
+ * 	version 3: timestamp(ms) filename action offset length
+ * File management lines (add, open, close) and syncs are skipped.  In
+ * version 2 logs, "wait" actions (offset in microseconds) advance time. */
+bool TraceFile::parse_fio(const char *line, TraceRecord &record)
+{
+	char action[16];
+	unsigned long long offset;
+	uint size = 0;
+	double timestamp;
+	uint version;
+
+	if (sscanf(line, "fio version %u iolog", &version) == 1)
+	{
+		fio_version = version;
+		return false;
+	}
+
+	if (fio_version >= 3)
+	{
+		if (sscanf(line, "%lf %*s %15s %llu %u", &timestamp, action, &offset, &size) != 4)
+			return false;
+		record.time = timestamp / 1000.0;
+	}
+	else
+	{
+		if (sscanf(line, "%*s %15s %llu %u", action, &offset, &size) < 2)
+			return false;
+		if (strcmp(action, "wait") == 0)
+		{
+			fio_time += offset / 1000000.0;
+			return false;
+		}
+		record.time = fio_time;
+	}
+
+	if (strcmp(action, "read") == 0)
+		record.type = READ;
+	else if (strcmp(action, "write") == 0)
+		record.type = WRITE;
+	else if (strcmp(action, "trim") == 0)
+		record.type = TRIM;
+	else
+		return false;
+
+	record.offset = offset;
+	record.size = size;
+	return true;
+}
+
+BinaryTraceFile::BinaryTraceFile(const char *path):
+	fd(-1),
+	map(NULL),
+	length(0),
+	header(NULL),
+	records(NULL),
+	index(0),
+	released(0)
+{
+	struct stat st;
+
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+	{
+		fprintf(stderr, "BinaryTraceFile error: %s: cannot open trace file %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	length = st.st_size;
+	if (length < sizeof(BinaryTraceHeader))
+	{
+		fprintf(stderr, "BinaryTraceFile error: %s: %s is too short for a binary trace\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	map = (char *) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		fprintf(stderr, "BinaryTraceFile error: %s: cannot map trace file %s\n", __func__, path);
+		exit(MEM_ERR);
+	}
+	madvise(map, length, MADV_SEQUENTIAL);
+
+	header = (const BinaryTraceHeader *) map;
+	records = (const BinaryTraceRecord *) (map + sizeof(BinaryTraceHeader));
+
+	if (memcmp(header -> magic, BINARY_TRACE_MAGIC, 4) != 0 || header -> version != BINARY_TRACE_VERSION)
+	{
+		fprintf(stderr, "BinaryTraceFile error: %s: %s is not a version %d binary trace\n", __func__, path, BINARY_TRACE_VERSION);
+		exit(FILE_ERR);
+	}
+	if (sizeof(BinaryTraceHeader) + header -> num_records * sizeof(BinaryTraceRecord) > length)
+	{
+		fprintf(stderr, "BinaryTraceFile error: %s: %s is truncated\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	seconds_per_unit = header -> time_unit * 1e-9;
+	time = header -> base_time;
+	offset = header -> base_offset;
+}
+
+BinaryTraceFile::~BinaryTraceFile(void)
+{
+	if (map != NULL)
+		munmap(map, length);
+	if (fd >= 0)
+		close(fd);
+}
+
+bool BinaryTraceFile::next(TraceRecord &record)
+{
+	while (index < header -> num_records)
+	{
+		const BinaryTraceRecord &raw = records[index++];
+
+		time += raw.time_delta;
+		offset += raw.offset_delta;
+
+		if (raw.op == BT_NOP)
+			continue;
+
+		release_consumed(map, (const char *) &records[index] - map, released);
+
+		record.time = time * seconds_per_unit;
+		record.type = (raw.op == BT_READ) ? READ : (raw.op == BT_WRITE) ? WRITE : TRIM;
+		record.offset = offset;
+		record.size = raw.size;
+		record.stream = raw.stream;
+		return true;
+	}
+	return false;
+}
+
+void BinaryTraceFile::rewind(void)
+{
+	index = 0;
+	released = 0;
+	time = header -> base_time;
+	offset = header -> base_offset;
+	madvise(map, length, MADV_SEQUENTIAL);
+}
+
+const BinaryTraceHeader &BinaryTraceFile::get_header(void) const
+{
+	return *header;
+}
+
+/* time_unit is the length of one time unit in nanoseconds; it bounds the
+ * timestamp resolution kept from the source trace. */
+BinaryTraceWriter::BinaryTraceWriter(const char *path, enum trace_format source_format, uint32_t time_unit):
+	time(0),
+	offset(0)
+{
+	assert(sizeof(BinaryTraceHeader) == 64 && sizeof(BinaryTraceRecord) == 24);
+	assert(time_unit > 0);
+
+	if ((file = fopen(path, "wb")) == NULL)
+	{
+		fprintf(stderr, "BinaryTraceWriter error: %s: cannot create %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_TRACE_MAGIC, 4);
+	header.version = BINARY_TRACE_VERSION;
+	header.source_format = source_format;
+	header.time_unit = time_unit;
+
+	/* placeholder until close() knows the record count */
+	if (fwrite(&header, sizeof(header), 1, file) != 1)
+	{
+		fprintf(stderr, "BinaryTraceWriter error: %s: write failed\n", __func__);
+		exit(FILE_ERR);
+	}
+}
+
+BinaryTraceWriter::~BinaryTraceWriter(void)
+{
+	if (file != NULL)
+		close();
+}
+
+void BinaryTraceWriter::write_record(const BinaryTraceRecord &record)
+{
+	if (fwrite(&record, sizeof(record), 1, file) != 1)
+	{
+		fprintf(stderr, "BinaryTraceWriter error: %s: write failed\n", __func__);
+		exit(FILE_ERR);
+	}
+	header.num_records++;
+}
+
+void BinaryTraceWriter::append(const TraceRecord &record)
+{
+	BinaryTraceRecord raw;
+	uint64_t record_time = (uint64_t) (record.time * 1e9 / header.time_unit + 0.5);
+
+	assert(file != NULL);
+	memset(&raw, 0, sizeof(raw));
+
+	if (header.num_records == 0)
+	{
+		header.base_time = record_time;
+		header.base_offset = record.offset;
+		time = record_time;
+		offset = record.offset;
+	}
+	if (record_time < time)
+		record_time = time;
+
+	raw.op = BT_NOP;
+	while (record_time - time > UINT32_MAX)
+	{
+		raw.time_delta = UINT32_MAX;
+		time += UINT32_MAX;
+		write_record(raw);
+	}
+
+	raw.time_delta = record_time - time;
+	raw.size = record.size;
+	raw.offset_delta = (int64_t) (record.offset - offset);
+	raw.stream = record.stream;
+	raw.op = (record.type == READ) ? BT_READ : (record.type == WRITE) ? BT_WRITE : BT_TRIM;
+	write_record(raw);
+
+	time = record_time;
+	offset = record.offset;
+}
+
+void BinaryTraceWriter::close(void)
+{
+	assert(file != NULL);
+
+	if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1 || fclose(file) != 0)
+	{
+		fprintf(stderr, "BinaryTraceWriter error: %s: write failed\n", __func__);
+		exit(FILE_ERR);
+	}
+	file = NULL;
+}
+
+uint64_t BinaryTraceWriter::get_num_records(void) const
+{
+	return header.num_records;
+}
+
+TraceSource *ssd::open_trace(const char *path, enum trace_format format)
+{
+	TraceSource *source = NULL;
+
+	if (format == TRACE_BINARY)
+		source = new BinaryTraceFile(path);
+	else
+		source = new TraceFile(path, format);
+
+	if (source == NULL)
+	{
+		fprintf(stderr, "Trace error: %s: could not allocate trace source\n", __func__);
+		exit(MEM_ERR);
+	}
+	return source;
+}
+
+bool ssd::trace_format_from_name(const char *name, enum trace_format &format)
+{
+	if (strcasecmp(name, "msr") == 0)
+		format = TRACE_MSR;
+	else if (strcasecmp(name, "spc") == 0)
+		format = TRACE_SPC;
+	else if (strcasecmp(name, "blkparse") == 0)
+		format = TRACE_BLKPARSE;
+	else if (strcasecmp(name, "fio") == 0)
+		format = TRACE_FIO;
+	else if (strcasecmp(name, "binary") == 0)
+		format = TRACE_BINARY;
+	else
+		return false;
+	return true;
+}
+
+TraceReplayer::TraceReplayer(Ssd &ssd, TraceSource &source):
+	ssd(ssd),
+	source(source),
+	/* config files shipped with FlashSim use milliseconds */
+	time_units(1000.0),
+	time_scale(1.0),
+	lba_offset(0),
+	lba_modulo(ssd.get_controller().get_ftl().get_logical_pages()),
+	queue_depth(0),
+	think_time(0.0),
+	first_time(-1.0),
+	end_time(0.0)
+{
+	for (uint i = 0; i <= TRIM; i++)
+	{
+		num_requests[i] = 0;
+		num_pages[i] = 0;
+		total_response[i] = 0.0;
+		max_response[i] = 0.0;
+	}
+}
+
+/* Simulator time units per trace second; must match the config file. */
+void TraceReplayer::set_time_units(double units_per_second)
+{
+	assert(units_per_second > 0.0);
+	time_units = units_per_second;
+}
+
+/* Inter-arrival times are multiplied by the scale: 0.5 replays twice as
+ * fast, 2.0 half as fast. */
+void TraceReplayer::set_time_scale(double scale)
+{
+	assert(scale >= 0.0);
+	time_scale = scale;
+}
+
+void TraceReplayer::set_lba_offset(ulong pages)
+{
+	lba_offset = pages;
+}
+
+void TraceReplayer::set_lba_modulo(ulong pages)
+{
+	assert(pages > 0);
+	lba_modulo = pages;
+}
+
+/* 0 selects open-loop replay. */
+void TraceReplayer::set_queue_depth(uint depth)
+{
+	queue_depth = depth;
+}
+
+/* Closed-loop only: a queue slot stays idle this long (in trace seconds)
+ * after each completion before issuing again. */
+void TraceReplayer::set_think_time(double seconds)
+{
+	assert(seconds >= 0.0);
+	think_time = seconds;
+}
+
+/* Replay up to max_requests requests (0 for the whole trace).  May be called
+ * repeatedly; replay continues from where the source stands and the
+ * simulated clock carries on from the last completion. */
+ulong TraceReplayer::replay(ulong max_requests)
+{
+	std::priority_queue<double, std::vector<double>, std::greater<double> > slots;
+	double base_time = end_time;
+	TraceRecord record;
+	ulong count = 0;
+
+	for (uint i = 0; i < queue_depth; i++)
+		slots.push(base_time);
+
+	while ((max_requests == 0 || count < max_requests) && source.next(record))
+	{
+		double start_time;
+
+		if (queue_depth == 0)
+		{
+			if (first_time < 0.0)
+				first_time = record.time;
+			start_time = (record.time - first_time) * time_scale * time_units;
+			if (start_time < 0.0)
+				start_time = 0.0;
+			issue(record, start_time);
+		}
+		else
+		{
+			start_time = slots.top();
+			slots.pop();
+			slots.push(start_time + issue(record, start_time) + think_time * time_units);
+		}
+		count++;
+	}
+	return count;
+}
+
+double TraceReplayer::issue(const TraceRecord &record, double start_time)
+{
+	ulong first = record.offset / PAGE_SIZE;
+	ulong last = (record.offset + (record.size > 0 ? record.size : 1) - 1) / PAGE_SIZE;
+	ulong pages = last - first + 1;
+	ulong lpn;
+	double time_taken;
+
+	if (pages > lba_modulo)
+		pages = lba_modulo;
+	lpn = (first + lba_offset) % lba_modulo;
+	if (lpn + pages > lba_modulo)
+		lpn = lba_modulo - pages;
+
+	time_taken = ssd.event_arrive(record.type, lpn, pages, start_time);
+
+	num_requests[record.type]++;
+	num_pages[record.type] += pages;
+	total_response[record.type] += time_taken;
+	if (time_taken > max_response[record.type])
+		max_response[record.type] = time_taken;
+	if (start_time + time_taken > end_time)
+		end_time = start_time + time_taken;
+
+	return time_taken;
+}
+
+double TraceReplayer::get_end_time(void) const
+{
+	return end_time;
+}
+
+void TraceReplayer::print_statistics(FILE *stream)
+{
+	static const char *names[] = {"Read", "Write", "Erase", "Merge", "Trim"};
+
+	fprintf(stream, "Trace replay statistics:\n");
+	fprintf(stream, "-----------------\n");
+	for (uint i = 0; i <= TRIM; i++)
+	{
+		if (num_requests[i] == 0)
+			continue;
+		fprintf(stream, "%-5s Requests: %lu\t Pages: %lu\t Avg response: %f\t Max response: %f\n", names[i], num_requests[i], num_pages[i], total_response[i] / num_requests[i], max_response[i]);
+	}
+	fprintf(stream, "Last completion: %f\n", end_time);
+	fprintf(stream, "\n");
+}
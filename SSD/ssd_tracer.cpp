@@ -0,0 +1,261 @@
+/* ssd_tracer.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Tracer class
+ *
+ * Chrome trace-event JSON of every operation issued to the hardware.  All
+ * records go to one process; its threads are the tracks: host requests,
+ * FTL phases, the RAM buffer, one per channel and one per die, each split
+ * into lanes where operations overlap.  The simulator is single threaded,
+ * so the buffer needs no locking. */
+
+#include <new>
+#include <assert.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+#define TRACK_HOST 0
+#define TRACK_PHASES 1
+#define TRACK_RAM 2
+#define TRACK_CHANNEL(package) (3 + (package))
+#define TRACK_DIE(package, die) (3 + SSD_SIZE + (package) * PACKAGE_SIZE + (die))
+
+static const char *type_names[] = {"read", "program", "erase", "merge", "trim"};
+static const char *request_names[] = {"read", "write", "erase", "merge", "trim"};
+static const char *cause_names[NUM_EVENT_CAUSES] = {"host", "gc", "merge", "mapping", "wl"};
+
+Tracer::Tracer(Ssd &ssd, const char *path, double time_scale):
+	ssd(ssd),
+	time_scale(time_scale),
+	used(0),
+	num_records(0),
+	request(0),
+	lanes(TRACK_DIE(SSD_SIZE, 0))
+{
+	assert(time_scale > 0.0);
+
+	if ((file = fopen(path, "w")) == NULL)
+	{
+		fprintf(stderr, "Tracer error: %s: could not open %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	if ((buffer = new (std::nothrow) char[TRACER_BUFFER_SIZE]) == NULL)
+	{
+		fprintf(stderr, "Tracer error: %s: could not allocate trace buffer\n", __func__);
+		exit(MEM_ERR);
+	}
+
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		phase_ops[i] = 0;
+
+	append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+			"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"FlashSim\"}}");
+	ssd.set_tracer(this);
+}
+
+Tracer::~Tracer(void)
+{
+	append("\n]}\n");
+	flush();
+	ssd.set_tracer(NULL);
+	fclose(file);
+	delete [] buffer;
+}
+
+/* a host request starts: operations issued from now on belong to it */
+void Tracer::request_begin(void)
+{
+	request++;
+	for (uint i = 0; i < NUM_EVENT_CAUSES; i++)
+		phase_ops[i] = 0;
+}
+
+/* record the host request itself and the span of the GC, merge and mapping
+ * work it triggered */
+void Tracer::request_end(enum event_type type, ulong logical_address, uint size, double start_time, double time_taken)
+{
+	record(TRACK_HOST, start_time, time_taken, request_names[type], cause_names[CAUSE_HOST],
+			"\"request\":%lu,\"lpn\":%lu,\"size\":%u", request, logical_address, size);
+
+	for (uint i = CAUSE_HOST + 1; i < NUM_EVENT_CAUSES; i++)
+		if (phase_ops[i] > 0)
+			record(TRACK_PHASES, phase_start[i], phase_end[i] - phase_start[i], cause_names[i], "ftl",
+					"\"request\":%lu,\"ops\":%lu", request, phase_ops[i]);
+}
+
+void Tracer::channel(const Event &event, const char *name, double start_time, double duration, double wait)
+{
+	record(TRACK_CHANNEL(event.get_address().package), start_time, duration, name, cause_names[event.get_cause()],
+			"\"request\":%lu,\"wait\":%.3f", request, wait * time_scale);
+	phase(event, start_time, duration);
+}
+
+void Tracer::flash(const Event &event, double start_time, double duration)
+{
+	const Address &address = event.get_address();
+
+	record(TRACK_DIE(address.package, address.die), start_time, duration,
+			type_names[event.get_event_type()], cause_names[event.get_cause()],
+			"\"request\":%lu,\"lpn\":%lu,\"plane\":%u,\"block\":%u,\"page\":%u,\"noop\":%s",
+			request, event.get_logical_address(), address.plane, address.block, address.page,
+			event.get_noop() ? "true" : "false");
+	phase(event, start_time, duration);
+}
+
+void Tracer::ram(const Event &event, double start_time, double duration)
+{
+	record(TRACK_RAM, start_time, duration, "buffer", cause_names[event.get_cause()],
+			"\"request\":%lu", request);
+	phase(event, start_time, duration);
+}
+
+/* write out the buffered records */
+void Tracer::flush(void)
+{
+	if (used > 0 && fwrite(buffer, 1, used, file) != used)
+	{
+		fprintf(stderr, "Tracer error: %s: could not write trace\n", __func__);
+		exit(FILE_ERR);
+	}
+	used = 0;
+	fflush(file);
+}
+
+ulong Tracer::get_num_records(void) const
+{
+	return num_records;
+}
+
+ulong Tracer::get_num_requests(void) const
+{
+	return request;
+}
+
+/* first lane of the track that is free by start_time; once all lanes are
+ * taken, the one that frees up first
+ * channel reservations never overlap, though they may fill gaps left
+ * earlier, so channels keep to one lane */
+uint Tracer::lane(uint track, double start_time, double duration)
+{
+	std::vector<double> &ends = lanes[track];
+	uint best = 0;
+
+	if (track >= TRACK_CHANNEL(0) && track < TRACK_DIE(0, 0))
+	{
+		if (ends.size() == 0)
+		{
+			ends.push_back(0.0);
+			name_track(track, 0);
+		}
+		return 0;
+	}
+
+	while (best < ends.size() && ends[best] > start_time)
+		best++;
+
+	if (best == ends.size() && ends.size() < TRACER_MAX_LANES)
+	{
+		ends.push_back(0.0);
+		name_track(track, best);
+	}
+	else if (best == ends.size())
+	{
+		best = 0;
+		for (uint i = 1; i < ends.size(); i++)
+			if (ends[i] < ends[best])
+				best = i;
+	}
+
+	ends[best] = start_time + duration;
+	return best;
+}
+
+void Tracer::name_track(uint track, uint lane)
+{
+	uint tid = track * TRACER_MAX_LANES + lane + 1;
+	char name[64];
+	int length;
+
+	if (track == TRACK_HOST)
+		length = snprintf(name, sizeof(name), "host requests");
+	else if (track == TRACK_PHASES)
+		length = snprintf(name, sizeof(name), "ftl phases");
+	else if (track == TRACK_RAM)
+		length = snprintf(name, sizeof(name), "ram");
+	else if (track < TRACK_DIE(0, 0))
+		length = snprintf(name, sizeof(name), "channel %u", track - TRACK_CHANNEL(0));
+	else
+		length = snprintf(name, sizeof(name), "die %u.%u", (track - TRACK_DIE(0, 0)) / PACKAGE_SIZE, (track - TRACK_DIE(0, 0)) % PACKAGE_SIZE);
+
+	if (lane > 0)
+		snprintf(name + length, sizeof(name) - length, " #%u", lane + 1);
+
+	append(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}"
+			",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}",
+			tid, name, tid, tid);
+}
+
+/* one complete event; args is the format of the members of its args
+ * object */
+void Tracer::record(uint track, double start_time, double duration, const char *name, const char *category, const char *args, ...)
+{
+	uint tid = track * TRACER_MAX_LANES + lane(track, start_time, duration) + 1;
+	va_list ap;
+
+	append(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{",
+			name, category, start_time * time_scale, duration * time_scale, tid);
+
+	va_start(ap, args);
+	used += vsnprintf(buffer + used, TRACER_BUFFER_SIZE - used, args, ap);
+	va_end(ap);
+
+	append("}}");
+	num_records++;
+}
+
+/* format into the buffer, writing it out first if a record might not fit */
+void Tracer::append(const char *format, ...)
+{
+	va_list ap;
+
+	if (used + TRACER_RECORD_MAX > TRACER_BUFFER_SIZE)
+		flush();
+
+	va_start(ap, format);
+	used += vsnprintf(buffer + used, TRACER_BUFFER_SIZE - used, format, ap);
+	va_end(ap);
+	assert(used < TRACER_BUFFER_SIZE);
+}
+
+/* widen the span of the current request's phase for the event's cause */
+void Tracer::phase(const Event &event, double start_time, double duration)
+{
+	uint cause = event.get_cause();
+
+	if (cause == CAUSE_HOST)
+		return;
+
+	if (phase_ops[cause] == 0 || start_time < phase_start[cause])
+		phase_start[cause] = start_time;
+	if (phase_ops[cause] == 0 || start_time + duration > phase_end[cause])
+		phase_end[cause] = start_time + duration;
+	phase_ops[cause]++;
+}
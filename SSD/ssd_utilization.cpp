@@ -0,0 +1,105 @@
+/* ssd_utilization.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Utilization class
+ *
+ * Busy, idle and queueing time of one hardware resource.  Channels record
+ * their lock reservations, dies and planes the flash time events spend in
+ * them (see record_event). */
+
+#include <assert.h>
+#include <stdio.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+Utilization::Utilization(void)
+{
+	reset();
+}
+
+void Utilization::reset(void)
+{
+	ops = 0;
+	busy_time = 0.0;
+	queue_time = 0.0;
+	first_time = -1.0;
+	last_time = 0.0;
+}
+
+void Utilization::record(double start_time, double duration, double queue_time)
+{
+	assert(duration >= 0.0 && queue_time >= 0.0);
+
+	ops++;
+	busy_time += duration;
+	this -> queue_time += queue_time;
+
+	if (first_time < 0.0 || start_time < first_time)
+		first_time = start_time;
+	if (start_time + duration > last_time)
+		last_time = start_time + duration;
+}
+
+/* account the part of an event's time taken that was added since
+ * time_before, i.e. by the resource the event just passed through
+ * the operation is queued behind whatever this resource had not yet
+ * finished when it started */
+void Utilization::record_event(const Event &event, double time_before)
+{
+	double start_time = event.get_start_time() + time_before;
+	double overlap = (ops > 0 && last_time > start_time) ? last_time - start_time : 0.0;
+
+	record(start_time, event.get_time_taken() - time_before, overlap);
+}
+
+ulong Utilization::get_ops(void) const
+{
+	return ops;
+}
+
+double Utilization::get_busy_time(void) const
+{
+	return busy_time;
+}
+
+double Utilization::get_queue_time(void) const
+{
+	return queue_time;
+}
+
+double Utilization::get_first_time(void) const
+{
+	return first_time < 0.0 ? 0.0 : first_time;
+}
+
+double Utilization::get_last_time(void) const
+{
+	return last_time;
+}
+
+/* idle time within a span of simulated time, never negative even when
+ * overlapping operations add up to more busy time than the span */
+double Utilization::get_idle_time(double span) const
+{
+	return busy_time < span ? span - busy_time : 0.0;
+}
+
+double Utilization::get_utilization(double span) const
+{
+	return span > 0.0 ? busy_time / span : 0.0;
+}
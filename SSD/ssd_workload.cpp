@@ -0,0 +1,504 @@
+/* ssd_workload.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Workload class
+ *
+ * Synthetic request generator driven by fio-like job descriptions.  All
+ * randomness comes from a seeded xorshift128+ generator, so a job replays
+ * identically for a given seed.  Zipfian addresses are drawn with
+ * rejection-inversion sampling (Hörmann and Derflinger), which takes
+ * constant expected time and no per-page tables, and are scattered over
+ * the address range so hot pages do not all share a few blocks.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+/* Parse a size such as 4096, 4k, 16K, 1m or 2g (binary multiples) into
+ * bytes.  Returns false on garbage. */
+static bool parse_size(const char *value, double &bytes)
+{
+	char *end;
+
+	bytes = strtod(value, &end);
+	if (end == value || bytes < 0.0)
+		return false;
+
+	switch (*end)
+	{
+	case 'k': case 'K':
+		bytes *= 1024.0;
+		end++;
+		break;
+	case 'm': case 'M':
+		bytes *= 1024.0 * 1024.0;
+		end++;
+		break;
+	case 'g': case 'G':
+		bytes *= 1024.0 * 1024.0 * 1024.0;
+		end++;
+		break;
+	case 't': case 'T':
+		bytes *= 1024.0 * 1024.0 * 1024.0 * 1024.0;
+		end++;
+		break;
+	}
+	if (*end == 'i' || *end == 'I')
+		end++;
+	if (*end == 'b' || *end == 'B')
+		end++;
+	return *end == '\0';
+}
+
+/* Parse a size or a percentage of the device ("50%"). */
+static bool parse_range(const char *value, double &bytes, double &percent)
+{
+	size_t length = strlen(value);
+
+	if (length > 0 && value[length - 1] == '%')
+	{
+		char *end;
+		percent = strtod(value, &end);
+		bytes = 0.0;
+		return end == value + length - 1 && percent >= 0.0 && percent <= 100.0;
+	}
+	percent = -1.0;
+	return parse_size(value, bytes);
+}
+
+static uint64_t splitmix64(uint64_t &x)
+{
+	uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+	while (b != 0)
+	{
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+Workload::Workload(void):
+	sequential(false),
+	has_reads(true),
+	has_writes(false),
+	has_trims(false),
+	read_mix(0.5),
+	trim_ratio(0.0),
+	offset_bytes(0.0),
+	offset_percent(-1.0),
+	size_bytes(0.0),
+	size_percent(100.0),
+	distribution(DIST_UNIFORM),
+	zipf_theta(0.0),
+	hot_fraction(0.0),
+	hot_access(0.0),
+	iodepth(1),
+	think_time(0.0),
+	rate_iops(0.0),
+	number_ios(0),
+	seed(1)
+{
+	bs_entry entry = {PAGE_SIZE, 1.0};
+	block_sizes.push_back(entry);
+	rewind();
+}
+
+Workload::Workload(const char *path):
+	Workload()
+{
+	FILE *job_file = NULL;
+	char line[256], key[128], value[128];
+	uint line_number;
+
+	if ((job_file = fopen(path, "r")) == NULL)
+	{
+		fprintf(stderr, "Workload error: %s: cannot open job file %s\n", __func__, path);
+		exit(FILE_ERR);
+	}
+
+	for (line_number = 1; fgets(line, sizeof(line), job_file) != NULL; line_number++)
+	{
+		/* ignore comments, blank lines and section headers */
+		char *p = line + strspn(line, " \t");
+		if (*p == '#' || *p == ';' || *p == '[' || *p == '\n' || *p == '\0')
+			continue;
+
+		if (sscanf(p, " %127[^= \t] = %127s", key, value) != 2 || !set(key, value))
+			fprintf(stderr, "Job file parsing error on line %u\n", line_number);
+	}
+	fclose(job_file);
+}
+
+/* Set one job option; the generator restarts from the beginning. */
+bool Workload::set(const char *key, const char *value)
+{
+	double bytes, percent;
+	bool ok = true;
+
+	if (!strcmp(key, "rw") || !strcmp(key, "readwrite"))
+	{
+		const char *mode = value;
+		sequential = strncmp(mode, "rand", 4) != 0;
+		if (!sequential)
+			mode += 4;
+		has_reads = !strcmp(mode, "read") || !strcmp(mode, "rw") || !strcmp(mode, "readwrite");
+		has_writes = !strcmp(mode, "write") || !strcmp(mode, "rw") || !strcmp(mode, "readwrite");
+		has_trims = !strcmp(mode, "trim");
+		ok = has_reads || has_writes || has_trims;
+	}
+	else if (!strcmp(key, "rwmixread"))
+		read_mix = atof(value) / 100.0;
+	else if (!strcmp(key, "rwmixwrite"))
+		read_mix = 1.0 - atof(value) / 100.0;
+	else if (!strcmp(key, "trimratio"))
+		trim_ratio = atof(value) / 100.0;
+	else if (!strcmp(key, "bs"))
+	{
+		ok = parse_size(value, bytes) && bytes >= 1.0;
+		if (ok)
+		{
+			bs_entry entry = {(uint) bytes, 1.0};
+			block_sizes.assign(1, entry);
+		}
+	}
+	else if (!strcmp(key, "bssplit"))
+	{
+		/* size/weight:size/weight:... */
+		std::vector<bs_entry> split;
+		char list[128], *save = NULL;
+		double total = 0.0;
+
+		strncpy(list, value, sizeof(list) - 1);
+		list[sizeof(list) - 1] = '\0';
+		for (char *item = strtok_r(list, ":", &save); item != NULL && ok; item = strtok_r(NULL, ":", &save))
+		{
+			char *slash = strchr(item, '/');
+			bs_entry entry;
+			if (slash == NULL)
+			{
+				ok = false;
+				break;
+			}
+			*slash = '\0';
+			ok = parse_size(item, bytes) && bytes >= 1.0;
+			entry.size = (uint) bytes;
+			total += atof(slash + 1);
+			entry.cumulative = total;
+			split.push_back(entry);
+		}
+		ok = ok && !split.empty() && total > 0.0;
+		if (ok)
+		{
+			for (uint i = 0; i < split.size(); i++)
+				split[i].cumulative /= total;
+			split.back().cumulative = 1.0;
+			block_sizes = split;
+		}
+	}
+	else if (!strcmp(key, "offset"))
+		ok = parse_range(value, offset_bytes, offset_percent);
+	else if (!strcmp(key, "size"))
+		ok = parse_range(value, size_bytes, size_percent);
+	else if (!strcmp(key, "random_distribution"))
+	{
+		if (!strcmp(value, "random"))
+			distribution = DIST_UNIFORM;
+		else if (sscanf(value, "zipf:%lf", &zipf_theta) == 1 && zipf_theta > 0.0)
+			distribution = DIST_ZIPF;
+		else if (sscanf(value, "hotcold:%lf/%lf", &percent, &bytes) == 2 && percent > 0.0 && percent < 100.0)
+		{
+			distribution = DIST_HOTCOLD;
+			hot_fraction = percent / 100.0;
+			hot_access = bytes / 100.0;
+		}
+		else
+			ok = false;
+	}
+	else if (!strcmp(key, "iodepth"))
+		ok = (iodepth = atoi(value)) > 0;
+	else if (!strcmp(key, "thinktime"))
+		think_time = atof(value) / 1000000.0;
+	else if (!strcmp(key, "rate_iops"))
+		rate_iops = atof(value);
+	else if (!strcmp(key, "number_ios"))
+		number_ios = strtoul(value, NULL, 10);
+	else if (!strcmp(key, "randseed"))
+		seed = strtoull(value, NULL, 10);
+	else
+	{
+		fprintf(stderr, "Workload error: %s: unknown job option %s\n", __func__, key);
+		return false;
+	}
+
+	if (!ok)
+		fprintf(stderr, "Workload error: %s: invalid value %s for %s\n", __func__, value, key);
+	rewind();
+	return ok;
+}
+
+void Workload::rewind(void)
+{
+	ulong device_pages = (ulong) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE;
+	ulong max_pages = 0;
+	double mean_pages = 0.0, previous = 0.0;
+
+	/* the address range is relative to the configured device */
+	assert(device_pages > 0);
+
+	first_page = (offset_percent >= 0.0) ? (ulong) (device_pages * offset_percent / 100.0) : (ulong) (offset_bytes / PAGE_SIZE);
+	span_pages = (size_percent >= 0.0) ? (ulong) (device_pages * size_percent / 100.0) : (ulong) (size_bytes / PAGE_SIZE);
+	if (first_page >= device_pages)
+		first_page = 0;
+	if (span_pages == 0 || first_page + span_pages > device_pages)
+		span_pages = device_pages - first_page;
+
+	for (uint i = 0; i < block_sizes.size(); i++)
+	{
+		ulong pages = (block_sizes[i].size + PAGE_SIZE - 1) / PAGE_SIZE;
+		mean_pages += pages * (block_sizes[i].cumulative - previous);
+		previous = block_sizes[i].cumulative;
+		if (pages > max_pages)
+			max_pages = pages;
+	}
+	if (max_pages > span_pages)
+	{
+		fprintf(stderr, "Workload error: %s: block size exceeds the address range\n", __func__);
+		exit(-1);
+	}
+
+	limit = (number_ios > 0) ? number_ios : (ulong) (span_pages / mean_pages);
+	if (limit == 0)
+		limit = 1;
+
+	hot_pages = (ulong) (span_pages * hot_fraction);
+	if (hot_pages == 0)
+		hot_pages = 1;
+
+	if (distribution == DIST_ZIPF)
+	{
+		/* a stride coprime with the range turns rank order into a
+		 * permutation of all pages */
+		zipf_stride = 1;
+		if (span_pages > 1)
+		{
+			zipf_stride = 2654435761UL % span_pages;
+			while (zipf_stride == 0 || gcd(zipf_stride, span_pages) != 1)
+				zipf_stride = (zipf_stride + 1) % span_pages;
+		}
+
+		zipf_h_integral_x1 = zipf_h_integral(1.5) - 1.0;
+		zipf_h_integral_n = zipf_h_integral(span_pages + 0.5);
+		zipf_s = 2.0 - zipf_h_integral_inverse(zipf_h_integral(2.5) - zipf_h(2.0));
+	}
+
+	uint64_t x = seed;
+	state[0] = splitmix64(x);
+	state[1] = splitmix64(x);
+
+	cursor = 0;
+	issued = 0;
+}
+
+inline uint64_t Workload::random(void)
+{
+	uint64_t s1 = state[0];
+	const uint64_t s0 = state[1];
+	state[0] = s0;
+	s1 ^= s1 << 23;
+	state[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+	return state[1] + s0;
+}
+
+/* uniform in [0, 1) */
+inline double Workload::random_double(void)
+{
+	return (random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double Workload::zipf_h(double x) const
+{
+	return exp(-zipf_theta * log(x));
+}
+
+double Workload::zipf_h_integral(double x) const
+{
+	double log_x = log(x);
+	double t = (1.0 - zipf_theta) * log_x;
+	double helper = (fabs(t) > 1e-8) ? expm1(t) / t : 1.0 + t * 0.5 * (1.0 + t / 3.0 * (1.0 + 0.25 * t));
+	return helper * log_x;
+}
+
+double Workload::zipf_h_integral_inverse(double x) const
+{
+	double t = x * (1.0 - zipf_theta);
+	if (t < -1.0)
+		t = -1.0;
+	double helper = (fabs(t) > 1e-8) ? log1p(t) / t : 1.0 - t * (0.5 - t * (1.0 / 3.0 - 0.25 * t));
+	return exp(helper * x);
+}
+
+/* Zipf rank in [1, span_pages], rank 1 the most popular */
+ulong Workload::zipf_rank(void)
+{
+	while (true)
+	{
+		double u = zipf_h_integral_n + random_double() * (zipf_h_integral_x1 - zipf_h_integral_n);
+		double x = zipf_h_integral_inverse(u);
+		ulong k = (ulong) (x + 0.5);
+
+		if (k < 1)
+			k = 1;
+		else if (k > span_pages)
+			k = span_pages;
+
+		if (k - x <= zipf_s || u >= zipf_h_integral(k + 0.5) - zipf_h(k))
+			return k;
+	}
+}
+
+/* First page (relative to the range) of a request of the given size */
+ulong Workload::next_page(uint pages)
+{
+	ulong page;
+
+	if (sequential)
+	{
+		if (cursor + pages > span_pages)
+			cursor = 0;
+		page = cursor;
+		cursor += pages;
+		return page;
+	}
+
+	switch (distribution)
+	{
+	case DIST_ZIPF:
+		page = ((unsigned __int128) (zipf_rank() - 1) * zipf_stride) % span_pages;
+		break;
+	case DIST_HOTCOLD:
+		if (random_double() < hot_access || hot_pages >= span_pages)
+			page = ((unsigned __int128) random() * hot_pages) >> 64;
+		else
+			page = hot_pages + (((unsigned __int128) random() * (span_pages - hot_pages)) >> 64);
+		break;
+	default:
+		page = ((unsigned __int128) random() * span_pages) >> 64;
+		break;
+	}
+
+	if (page + pages > span_pages)
+		page = span_pages - pages;
+	return page;
+}
+
+bool Workload::next(TraceRecord &record)
+{
+	uint size = block_sizes[0].size;
+
+	if (issued >= limit)
+		return false;
+
+	if (block_sizes.size() > 1)
+	{
+		double u = random_double();
+		for (uint i = 0; i < block_sizes.size(); i++)
+			if (u < block_sizes[i].cumulative)
+			{
+				size = block_sizes[i].size;
+				break;
+			}
+	}
+
+	if (has_trims || (trim_ratio > 0.0 && random_double() < trim_ratio))
+		record.type = TRIM;
+	else if (has_reads && has_writes)
+		record.type = (random_double() < read_mix) ? READ : WRITE;
+	else
+		record.type = has_reads ? READ : WRITE;
+
+	record.offset = (first_page + next_page((size + PAGE_SIZE - 1) / PAGE_SIZE)) * (ulong) PAGE_SIZE;
+	record.size = size;
+	record.stream = 0;
+	record.time = (rate_iops > 0.0) ? issued / rate_iops : 0.0;
+
+	issued++;
+	return true;
+}
+
+/* Open loop at rate_iops if set, otherwise iodepth requests outstanding
+ * with thinktime between completion and reissue. */
+void Workload::configure(TraceReplayer &replayer) const
+{
+	if (rate_iops > 0.0)
+		replayer.set_queue_depth(0);
+	else
+	{
+		replayer.set_queue_depth(iodepth);
+		replayer.set_think_time(think_time);
+	}
+}
+
+ulong Workload::get_number_ios(void) const
+{
+	return limit;
+}
+
+void Workload::print(FILE *stream) const
+{
+	static const char *distributions[] = {"uniform", "zipf", "hotcold"};
+
+	fprintf(stream, "Workload:\n");
+	fprintf(stream, "-----------------\n");
+	fprintf(stream, "Pattern: %s%s%s%s\n", sequential ? "sequential" : "random", has_reads ? " read" : "", has_writes ? " write" : "", has_trims ? " trim" : "");
+	if (has_reads && has_writes)
+		fprintf(stream, "Read mix: %.1f%%\n", read_mix * 100.0);
+	fprintf(stream, "Trim ratio: %.1f%%\n", trim_ratio * 100.0);
+	fprintf(stream, "Block sizes:");
+	for (uint i = 0; i < block_sizes.size(); i++)
+		fprintf(stream, " %u (%.1f%%)", block_sizes[i].size, (block_sizes[i].cumulative - (i > 0 ? block_sizes[i - 1].cumulative : 0.0)) * 100.0);
+	fprintf(stream, "\n");
+	fprintf(stream, "Pages: %lu - %lu\n", first_page, first_page + span_pages - 1);
+	if (!sequential)
+	{
+		fprintf(stream, "Distribution: %s", distributions[distribution]);
+		if (distribution == DIST_ZIPF)
+			fprintf(stream, " theta %.2f", zipf_theta);
+		else if (distribution == DIST_HOTCOLD)
+			fprintf(stream, " %.1f%% of pages get %.1f%% of accesses", hot_fraction * 100.0, hot_access * 100.0);
+		fprintf(stream, "\n");
+	}
+	if (rate_iops > 0.0)
+		fprintf(stream, "Rate: %.1f IOPS (open loop)\n", rate_iops);
+	else
+		fprintf(stream, "Queue depth: %u\t Think time: %.1fus\n", iodepth, think_time * 1000000.0);
+	fprintf(stream, "Requests: %lu\t Seed: %lu\n", limit, (ulong) seed);
+	fprintf(stream, "\n");
+}
@@ -2,7 +2,18 @@
  * Standalone FlashSim simulator benchmarking client. Passing actual data
  * here, so MUST ensure that `PAGE_ENABLE_DATA` option in conf is set to 1.
  *
- * This is a synchronous benchmarking, not utilizing in-device parallelism.
+ * Open-loop mode sweeps arrival intensity through one submission thread
+ * per device. Closed-loop mode runs `JOBS` jobs each keeping `QD` requests
+ * outstanding, and sweeps queue depth instead. Both report throughput,
+ * IOPS and latency percentiles per step.
+ *
+ * In virtual-time mode nothing sleeps: arrivals follow a generated
+ * schedule and the simulator's returned latencies advance a virtual
+ * clock, so a full sweep runs at CPU speed.
+ *
+ * Given several sockets, the benchmark address space is striped over all
+ * of them, RAID-0 style, and results are reported both aggregated and
+ * per device.
  *
  * Author: Guanzhou Hu <guanzhou.hu@wisc.edu>, 2020.
  */
@@ -16,7 +27,8 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <numeric>
+#include <algorithm>
+#include <queue>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,6 +40,8 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#include "ssd.h"
+
 
 /**
  * Assuming default config, so total flash capacity should be 160MiB
@@ -84,101 +98,202 @@ struct req_entry {
     uint64_t start_time_us;
 };
 
-static std::deque<struct req_entry> submit_queue;
 
-static std::mutex submit_queue_lock;
-static std::condition_variable submit_queue_cv;
+/*========== Measurement window implementation BEGIN ==========*/
+
+/**
+ * Measurement window of the current round. Requests started inside the
+ * window have their latency recorded, in microseconds; requests finished
+ * inside the window count towards throughput. The first second of every
+ * round is left out as warm-up.
+ */
+struct bench_window {
+    uint64_t begin_time_us;
+    uint64_t end_time_us;
+    uint64_t bytes;
+    uint64_t ops;
+    ssd::Histogram hist = ssd::Histogram(1.0);
+};
+
+/**
+ * One simulated SSD behind a standalone simulator socket, with its own
+ * connection, submission queue (open-loop) and measurement window.
+ */
+struct device {
+    int index;
+    std::string sock_name;
+    int ssock;
+
+    /**
+     * The simulator serves a connection one request at a time, so every
+     * request/response exchange holds the socket lock. The simulated
+     * device time is returned to the caller, who sleeps it outside of
+     * the lock; this is what lets several closed-loop workers overlap.
+     */
+    std::mutex ssock_lock;
+
+    std::deque<struct req_entry> submit_queue;
+    std::mutex submit_queue_lock;
+    std::condition_variable submit_queue_cv;
+
+    /** Virtual-time open-loop: when this device's submitter is idle. */
+    uint64_t free_time_us;
+
+    struct bench_window window;
+    std::mutex window_lock;
+};
+
+static std::vector<struct device *> devices;
+
+/**
+ * Array-level address space is striped over all devices in units of
+ * `stripe_pages` pages, RAID-0 style. Each device contributes the
+ * largest whole number of stripe units that fits in `FLASH_SPACE`.
+ */
+static unsigned long stripe_pages = 1;
 
+static unsigned long
+array_space()
+{
+    return (FLASH_SPACE / PAGE_SIZE / stripe_pages) * stripe_pages
+           * PAGE_SIZE * devices.size();
+}
 
 /**
- * Open a client-side socket and connect to the given sock file.
+ * Map an array-level address to the device holding it. The
+ * device-level address is returned through `dev_addr`.
  */
-static std::string sock_name;
-static int ssock;
+static struct device *
+map_addr(unsigned long addr, unsigned long *dev_addr)
+{
+    unsigned long page = addr / PAGE_SIZE;
+    unsigned long unit = page / stripe_pages;
+
+    *dev_addr = ((unit / devices.size()) * stripe_pages
+                 + page % stripe_pages) * PAGE_SIZE;
+
+    return devices[unit % devices.size()];
+}
+
 
+/**
+ * Open a client-side socket and connect to the given device's sock file.
+ */
 static void
-prepare_socket()
+prepare_socket(struct device *dev)
 {
     struct sockaddr_un saddr;
     int ret;
 
-    ssock = socket(AF_LOCAL, SOCK_STREAM, 0);
-    if (ssock < 0)
+    dev->ssock = socket(AF_LOCAL, SOCK_STREAM, 0);
+    if (dev->ssock < 0)
         error("socket() failed");
 
     memset(&saddr, 0, sizeof(saddr));
     saddr.sun_family = AF_LOCAL;
-    strncpy(saddr.sun_path, sock_name.c_str(), sizeof(saddr.sun_path) - 1);
+    strncpy(saddr.sun_path, dev->sock_name.c_str(),
+            sizeof(saddr.sun_path) - 1);
 
-    ret = connect(ssock, (struct sockaddr *) &saddr, sizeof(saddr));
+    ret = connect(dev->ssock, (struct sockaddr *) &saddr, sizeof(saddr));
     if (ret)
         error("connect() failed");
 
-    std::cout << "Connected to local socket file `" << sock_name << "`..."
-              << std::endl;
+    std::cout << "Connected to local socket file `" << dev->sock_name
+              << "` as dev " << dev->index << "..." << std::endl;
 }
 
 
-/*========== Device log implementation BEGIN ==========*/
-
 /**
- * Device log for throughput measurement. It records the latest IOs
- * through this device.
+ * Record a finished IO into the device's current measurement window.
  */
-struct log_entry {
-    uint64_t start_time_us;
-    uint64_t finish_time_us;
-    uint32_t bytes;
-};
+void
+window_push_entry(struct device *dev, uint64_t start_time_us,
+                  uint64_t finish_time_us, uint32_t bytes)
+{
+    struct bench_window &window = dev->window;
+
+    std::lock_guard<std::mutex> lk(dev->window_lock);
 
-static const int DEVICE_LOG_LENGTH = 120000;
-static std::deque<struct log_entry> device_log;
+    if (start_time_us >= window.begin_time_us
+        && start_time_us < window.end_time_us)
+        window.hist.record(finish_time_us - start_time_us);
 
-static std::mutex device_log_lock;
+    if (finish_time_us >= window.begin_time_us
+        && finish_time_us < window.end_time_us) {
+        window.bytes += bytes;
+        window.ops++;
+    }
+}
 
 /**
- * Push a new IO entry into the log, possibly erase an oldest one if
- * the log is full. Returns the timestamp for this entry.
+ * Open a new measurement window on every device, dropping whatever the
+ * last one held.
  */
 void
-log_push_entry(uint64_t start_time_us, uint64_t finish_time_us,
-                     uint32_t bytes)
+window_reset(uint64_t begin_time_us, uint64_t end_time_us)
 {
-    struct log_entry entry;
-    entry.start_time_us = start_time_us;
-    entry.finish_time_us = finish_time_us;
-    entry.bytes = bytes;
-
-    std::lock_guard<std::mutex> lk(device_log_lock);
+    for (struct device *dev : devices) {
+        std::lock_guard<std::mutex> lk(dev->window_lock);
+
+        dev->window.begin_time_us = begin_time_us;
+        dev->window.end_time_us = end_time_us;
+        dev->window.bytes = 0;
+        dev->window.ops = 0;
+        dev->window.hist.reset();
+    }
+}
 
-    device_log.push_back(entry);
+static void
+_window_print(const char *label, const struct bench_window &window)
+{
+    double secs = (window.end_time_us - window.begin_time_us) / 1000000.0;
 
-    if (device_log.size() > DEVICE_LOG_LENGTH)
-        device_log.pop_front();
+    printf("  %20s     %15.5lf  %12.1lf  %10.0lf  %10.0lf  %10.0lf  %10.0lf\n",
+           label, (window.bytes / 1024.0) / secs, window.ops / secs,
+           window.hist.percentile(50.0), window.hist.percentile(99.0),
+           window.hist.percentile(99.9), window.hist.get_max());
 }
 
 /**
- * Query the log for throughput (KB/s) of given time interval.
+ * Print one result line: x-axis value, throughput (KB/s), IOPS and
+ * latency percentiles (us) aggregated over all devices. With more than
+ * one device, a line per device follows, labelled `dev N`.
  */
-double
-log_query_throughput(uint64_t begin_time_us, uint64_t end_time_us)
+void
+window_report(int x_value)
 {
-    double kilobytes = 0.0;
+    struct bench_window total;
+    char label[32];
 
-    std::lock_guard<std::mutex> lk(device_log_lock);
+    total.begin_time_us = devices[0]->window.begin_time_us;
+    total.end_time_us = devices[0]->window.end_time_us;
+    total.bytes = 0;
+    total.ops = 0;
 
-    for (auto it = device_log.rbegin(); it != device_log.rend(); ++it) {
-        if (it->finish_time_us <= begin_time_us)
-            break;
+    for (struct device *dev : devices) {
+        std::lock_guard<std::mutex> lk(dev->window_lock);
+
+        total.bytes += dev->window.bytes;
+        total.ops += dev->window.ops;
+        total.hist.merge(dev->window.hist);
+    }
+
+    snprintf(label, sizeof(label), "%d", x_value);
+    _window_print(label, total);
 
-        if (it->finish_time_us <= end_time_us)
-            kilobytes += (double) it->bytes / 1024.0;
+    if (devices.size() > 1) {
+        for (struct device *dev : devices) {
+            std::lock_guard<std::mutex> lk(dev->window_lock);
+
+            snprintf(label, sizeof(label), "dev %d", dev->index);
+            _window_print(label, dev->window);
+        }
     }
 
-    return (kilobytes * 1000000) / (end_time_us - begin_time_us);
+    fflush(stdout);
 }
 
-/*========== Device log implementation END ==========*/
+/*========== Measurement window implementation END ==========*/
 
 
 /**
@@ -198,10 +313,11 @@ static const int DIR_READ  = 0;
 static const int DIR_WRITE = 1;
 
 /**
- * Issuing a write / read request.
+ * Issuing a write / read request. Returns simulated time used.
  */
-static void
-_submit_write(unsigned long addr, unsigned int size, uint64_t start_time_us)
+static uint64_t
+_submit_write(struct device *dev, unsigned long addr, unsigned int size,
+              uint64_t start_time_us)
 {
     struct req_header header;
     int rbytes, wbytes;
@@ -213,33 +329,36 @@ _submit_write(unsigned long addr, unsigned int size, uint64_t start_time_us)
 
     data = malloc(size);
 
+    std::lock_guard<std::mutex> lk(dev->ssock_lock);
+
     // Request header.
     header.direction = DIR_WRITE;
     header.addr = addr;
     header.size = size;
     header.start_time_us = start_time_us;
 
-    wbytes = write(ssock, &header, REQ_HEADER_LENGTH);
+    wbytes = write(dev->ssock, &header, REQ_HEADER_LENGTH);
     if (wbytes != REQ_HEADER_LENGTH)
         error("write request header send failed");
 
     // Data to write.
-    wbytes = write(ssock, data, header.size);
+    wbytes = write(dev->ssock, data, header.size);
     if (wbytes != (int) header.size)
         error("write request data send failed");
 
     // Processing time respond.
-    rbytes = read(ssock, &time_used_us, 8);
+    rbytes = read(dev->ssock, &time_used_us, 8);
     if (rbytes != 8)
         error("write processing time recv failed");
 
-    usleep(time_used_us);
-
     free(data);
+
+    return time_used_us;
 }
 
-static void
-_submit_read(unsigned long addr, unsigned int size, uint64_t start_time_us)
+static uint64_t
+_submit_read(struct device *dev, unsigned long addr, unsigned int size,
+             uint64_t start_time_us)
 {
     struct req_header header;
     int rbytes, wbytes;
@@ -251,36 +370,58 @@ _submit_read(unsigned long addr, unsigned int size, uint64_t start_time_us)
 
     data = malloc(size);
 
+    std::lock_guard<std::mutex> lk(dev->ssock_lock);
+
     // Request header.
     header.direction = DIR_READ;
     header.addr = addr;
     header.size = size;
     header.start_time_us = start_time_us;
 
-    wbytes = write(ssock, &header, REQ_HEADER_LENGTH);
+    wbytes = write(dev->ssock, &header, REQ_HEADER_LENGTH);
     if (wbytes != REQ_HEADER_LENGTH)
         error("read request header send failed");
 
     // Data read out respond.
-    rbytes = read(ssock, data, header.size);
+    rbytes = read(dev->ssock, data, header.size);
     if (rbytes != (int) header.size)
         error("read request data recv failed");
 
     // Processing time respond.
-    rbytes = read(ssock, &time_used_us, 8);
+    rbytes = read(dev->ssock, &time_used_us, 8);
     if (rbytes != 8)
         error("read processing time recv failed");
 
-    usleep(time_used_us);
-
     free(data);
+
+    return time_used_us;
+}
+
+static uint64_t
+_submit(struct device *dev, unsigned int direction, unsigned long addr,
+        unsigned int size, uint64_t start_time_us)
+{
+    if (direction == DIR_WRITE)
+        return _submit_write(dev, addr, size, start_time_us);
+    else
+        return _submit_read(dev, addr, size, start_time_us);
 }
 
 /**
- * Submission thread runs separately.
+ * Issue a request and wait out its simulated processing time.
  */
 static void
-_submit_thread_func()
+_submit_and_wait(struct device *dev, unsigned int direction,
+                 unsigned long addr, unsigned int size)
+{
+    usleep(_submit(dev, direction, addr, size, get_cur_time_us()));
+}
+
+/**
+ * Submission thread runs separately, one per device.
+ */
+static void
+_submit_thread_func(struct device *dev)
 {
     unsigned int direction;
     unsigned long addr;
@@ -290,352 +431,469 @@ _submit_thread_func()
     while (1) {
         {
             /** Wait when list is empty. */
-            std::unique_lock<std::mutex> lk(submit_queue_lock);
-            submit_queue_cv.wait(lk, []{ return submit_queue.size() > 0; });
+            std::unique_lock<std::mutex> lk(dev->submit_queue_lock);
+            dev->submit_queue_cv.wait(lk, [dev]{
+                return dev->submit_queue.size() > 0;
+            });
 
             /** Extract an entry from queue head. */
-            direction = submit_queue.front().direction;
-            addr = submit_queue.front().addr;
-            size = submit_queue.front().size;
-            start_time_us = submit_queue.front().start_time_us;
+            direction = dev->submit_queue.front().direction;
+            addr = dev->submit_queue.front().addr;
+            size = dev->submit_queue.front().size;
+            start_time_us = dev->submit_queue.front().start_time_us;
 
-            submit_queue.pop_front();
+            dev->submit_queue.pop_front();
         }
 
-        /** Process the request. */
-        switch (direction) {
-        case DIR_WRITE:
-            _submit_write(addr, size, start_time_us);
-            break;
-        case DIR_READ:
-            _submit_read(addr, size, start_time_us);
-            break;
-        }
+        /**
+         * Process the request. Latency is taken from the scheduled
+         * arrival, so time spent waiting in the submission queue counts.
+         */
+        _submit_and_wait(dev, direction, addr, size);
 
-        log_push_entry(start_time_us, get_cur_time_us(), size);
+        window_push_entry(dev, start_time_us, get_cur_time_us(), size);
     }
 }
 
 
 /*========== Benchmarking Implemention BEGIN. ==========*/
 
-/** Clearing after round. */
-static inline void
-bench_clean_up()
-{
-    usleep(2000000);
+/** Load generation mode & shape, set from the command line. */
+enum bench_mode {
+    MODE_OPEN,      // fixed arrival rate, swept over intensities
+    MODE_CLOSED     // fixed #outstanding requests, swept over queue depths
+};
 
-    std::unique_lock<std::mutex> lk1(submit_queue_lock, std::defer_lock);
-    std::unique_lock<std::mutex> lk2(device_log_lock, std::defer_lock);
-    std::lock(lk1, lk2);
+/** Clock driving the benchmark, set from the command line. */
+enum time_mode {
+    TIME_WALL,      // real time, sleeping out every simulated latency
+    TIME_VIRTUAL    // simulated time only, nothing ever sleeps
+};
 
-    submit_queue.clear();
-    device_log.clear();
-}
+static enum bench_mode mode = MODE_OPEN;
+static enum time_mode time_mode = TIME_WALL;
+static int num_jobs = 1;
+static int max_qd = 1;
 
 /**
- * Benchmark - sequential read.
+ * Address stream of one job. Sequential jobs start at evenly spaced
+ * offsets so they do not trample over each other; all queue slots of a
+ * job share its stream.
  */
-static void
-bench_seq_read()
+struct job_stream {
+    std::mutex lock;
+    unsigned long addr;
+    std::default_random_engine rand_gen;
+};
+
+static unsigned long
+job_next_addr(struct job_stream *job, bool random)
 {
-    unsigned long addr = 0;
+    std::uniform_int_distribution<unsigned long> addr_dist(0,
+                                                           array_space()
+                                                           / PAGE_SIZE - 1);
+    unsigned long addr;
 
-    std::cout << "Benchmark - Logical Sequential Read:"         << std::endl
-              << "  Intensity (#4K-Reqs/s)   Throughput (KB/s)" << std::endl;
+    std::lock_guard<std::mutex> lk(job->lock);
 
-    for (int intensity = INTENSITY_TICK; intensity <= MAX_INTENSITY;
-         intensity += INTENSITY_TICK) {
+    if (random)
+        return PAGE_SIZE * addr_dist(job->rand_gen);
 
-        /** A round of benchmarking for given intensity. */
-        uint64_t delta_us = 1000000 / intensity;
-        uint64_t base_time_us, cur_time_us, log_interval_us = 0;
-        std::vector<double> throughputs;
+    addr = job->addr;
+    job->addr = (job->addr + PAGE_SIZE) % array_space();
+    return addr;
+}
 
-        base_time_us = get_cur_time_us();
-        cur_time_us = base_time_us;
-        log_interval_us = 0;
+/**
+ * Virtual clock, in us. Only moves forward: each round starts where the
+ * last completion of the previous round left it, so the simulator sees
+ * one monotone timeline across the whole run.
+ */
+static uint64_t virt_time_us = 0;
 
-        do {
-            struct req_entry entry;
-            uint64_t new_time_us = get_cur_time_us();
+/**
+ * Requests still queued this long after a round ends are dropped, in both
+ * time modes, so overloaded open-loop rounds terminate.
+ */
+static const int DRAIN_SECS = 2;
 
-            entry.direction = DIR_READ;
-            entry.addr = addr;
-            entry.size = PAGE_SIZE;
-            entry.start_time_us = new_time_us;
+/** Clearing after round. */
+static inline void
+bench_clean_up()
+{
+    /** Let the submission thread drain in wall-clock open-loop mode. */
+    if (mode == MODE_OPEN && time_mode == TIME_WALL)
+        usleep(1000000 * DRAIN_SECS);
 
-            if (new_time_us - base_time_us >= 1000000)
-                log_interval_us += new_time_us - cur_time_us;
-            cur_time_us = new_time_us;
+    for (struct device *dev : devices) {
+        std::lock_guard<std::mutex> lk(dev->submit_queue_lock);
 
-            if (log_interval_us > 100000) {
-                throughputs.push_back(log_query_throughput(cur_time_us
-                                                           - log_interval_us,
-                                                           cur_time_us));
-                log_interval_us = 0;
-            }
+        dev->submit_queue.clear();
+    }
+}
 
-            {
-                std::lock_guard<std::mutex> lk(submit_queue_lock);
+/**
+ * A round of open-loop benchmarking at given intensity: requests arrive
+ * every 1/intensity seconds regardless of how fast the device is.
+ */
+static void
+bench_open_loop_round(struct job_stream *job, unsigned int direction,
+                      bool random, int intensity)
+{
+    uint64_t delta_us = 1000000 / intensity;
+    uint64_t base_time_us, cur_time_us;
 
-                submit_queue.push_back(entry);
-                submit_queue_cv.notify_all();
-            }
+    base_time_us = get_cur_time_us();
+    window_reset(base_time_us + 1000000,
+                 base_time_us + 1000000 * SECS_PER_ROUND);
 
-            usleep(delta_us);
+    do {
+        struct req_entry entry;
+        struct device *dev;
 
-            addr = (addr + PAGE_SIZE) % FLASH_SPACE;
-        } while (cur_time_us < base_time_us + 1000000 * SECS_PER_ROUND);
+        cur_time_us = get_cur_time_us();
 
-        double avg_throughput = std::accumulate(throughputs.begin(),
-                                                throughputs.end(),
-                                                0.0) / throughputs.size();
-        printf("  %20d     %15.5lf\n", intensity, avg_throughput);
-        fflush(stdout);
+        entry.direction = direction;
+        dev = map_addr(job_next_addr(job, random), &entry.addr);
+        entry.size = PAGE_SIZE;
+        entry.start_time_us = cur_time_us;
 
-        bench_clean_up();
-    }
+        {
+            std::lock_guard<std::mutex> lk(dev->submit_queue_lock);
+
+            dev->submit_queue.push_back(entry);
+            dev->submit_queue_cv.notify_all();
+        }
+
+        usleep(delta_us);
+    } while (cur_time_us < base_time_us + 1000000 * SECS_PER_ROUND);
 }
 
 /**
- * Benchmark - sequential write.
+ * Virtual-time equivalent of `bench_open_loop_round()`. Arrivals follow
+ * the same fixed schedule; like the device's submission thread, a
+ * request is dispatched no earlier than the completion of the previous
+ * one on that device, and its latency counts from the scheduled arrival.
  */
 static void
-bench_seq_write()
+bench_open_loop_round_virtual(struct job_stream *job, unsigned int direction,
+                              bool random, int intensity)
 {
-    unsigned long addr = 0;
-
-    std::cout << "Benchmark - Logical Sequential Write:"        << std::endl
-              << "  Intensity (#4K-Reqs/s)   Throughput (KB/s)" << std::endl;
+    uint64_t delta_us = 1000000 / intensity;
+    uint64_t base_time_us, end_time_us;
 
-    for (int intensity = INTENSITY_TICK; intensity <= MAX_INTENSITY;
-         intensity += INTENSITY_TICK) {
+    base_time_us = virt_time_us;
+    end_time_us = base_time_us + 1000000 * SECS_PER_ROUND;
+    window_reset(base_time_us + 1000000, end_time_us);
 
-        /** A round of benchmarking for given intensity. */
-        uint64_t delta_us = 1000000 / intensity;
-        uint64_t base_time_us, cur_time_us, log_interval_us = 0;
-        std::vector<double> throughputs;
+    for (struct device *dev : devices)
+        dev->free_time_us = base_time_us;
 
-        base_time_us = get_cur_time_us();
-        cur_time_us = base_time_us;
-        log_interval_us = 0;
+    for (uint64_t arrival_us = base_time_us; arrival_us < end_time_us;
+         arrival_us += delta_us) {
+        unsigned long addr;
+        struct device *dev = map_addr(job_next_addr(job, random), &addr);
+        uint64_t dispatch_us = std::max(arrival_us, dev->free_time_us);
 
-        do {
-            struct req_entry entry;
-            uint64_t new_time_us = get_cur_time_us();
+        /** Dropped, as if still queued when the drain period ran out. */
+        if (dispatch_us >= end_time_us + 1000000 * DRAIN_SECS)
+            continue;
 
-            entry.direction = DIR_WRITE;
-            entry.addr = addr;
-            entry.size = PAGE_SIZE;
-            entry.start_time_us = new_time_us;
+        dev->free_time_us = dispatch_us
+                            + _submit(dev, direction, addr, PAGE_SIZE,
+                                      dispatch_us);
 
-            if (new_time_us - base_time_us >= 1000000)
-                log_interval_us += new_time_us - cur_time_us;
-            cur_time_us = new_time_us;
-
-            if (log_interval_us > 100000) {
-                throughputs.push_back(log_query_throughput(cur_time_us
-                                                           - log_interval_us,
-                                                           cur_time_us));
-                log_interval_us = 0;
-            }
-
-            {
-                std::lock_guard<std::mutex> lk(submit_queue_lock);
+        window_push_entry(dev, arrival_us, dev->free_time_us, PAGE_SIZE);
+    }
 
-                submit_queue.push_back(entry);
-                submit_queue_cv.notify_all();
-            }
+    virt_time_us = end_time_us;
+    for (struct device *dev : devices)
+        virt_time_us = std::max(virt_time_us, dev->free_time_us);
+}
 
-            usleep(delta_us);
+/**
+ * Closed-loop worker: keeps exactly one request of its job outstanding
+ * until the round ends, issuing the next one as soon as the last one
+ * completes.
+ */
+static void
+_closed_loop_worker(struct job_stream *job, unsigned int direction,
+                    bool random, uint64_t end_time_us)
+{
+    uint64_t start_time_us;
 
-            addr = (addr + PAGE_SIZE) % FLASH_SPACE;
-        } while (cur_time_us < base_time_us + 1000000 * SECS_PER_ROUND);
+    while ((start_time_us = get_cur_time_us()) < end_time_us) {
+        unsigned long addr;
+        struct device *dev = map_addr(job_next_addr(job, random), &addr);
 
-        double avg_throughput = std::accumulate(throughputs.begin(),
-                                                throughputs.end(),
-                                                0.0) / throughputs.size();
-        printf("  %20d     %15.5lf\n", intensity, avg_throughput);
-        fflush(stdout);
+        _submit_and_wait(dev, direction, addr, PAGE_SIZE);
 
-        bench_clean_up();
+        window_push_entry(dev, start_time_us, get_cur_time_us(), PAGE_SIZE);
     }
 }
 
 /**
- * Benchmark - uniformly random read.
+ * A round of closed-loop benchmarking: `num_jobs` jobs each keeping `qd`
+ * requests in flight.
  */
 static void
-bench_rnd_read()
+bench_closed_loop_round(struct job_stream *jobs, unsigned int direction,
+                        bool random, int qd)
 {
-    std::default_random_engine rand_gen;
-    std::uniform_int_distribution<unsigned long> addr_dist(0,
-                                                           FLASH_SPACE
-                                                           / PAGE_SIZE);
-
-    std::cout << "Benchmark - Uniformly Random Read:"           << std::endl
-              << "  Intensity (#4K-Reqs/s)   Throughput (KB/s)" << std::endl;
+    std::vector<std::thread> workers;
+    uint64_t base_time_us, end_time_us;
 
-    for (int intensity = INTENSITY_TICK; intensity <= MAX_INTENSITY;
-         intensity += INTENSITY_TICK) {
+    base_time_us = get_cur_time_us();
+    end_time_us = base_time_us + 1000000 * SECS_PER_ROUND;
+    window_reset(base_time_us + 1000000, end_time_us);
 
-        /** A round of benchmarking for given intensity. */
-        uint64_t delta_us = 1000000 / intensity;
-        uint64_t base_time_us, cur_time_us, log_interval_us = 0;
-        std::vector<double> throughputs;
+    for (int j = 0; j < num_jobs; ++j)
+        for (int slot = 0; slot < qd; ++slot)
+            workers.push_back(std::thread(_closed_loop_worker, &jobs[j],
+                                          direction, random, end_time_us));
 
-        base_time_us = get_cur_time_us();
-        cur_time_us = base_time_us;
-        log_interval_us = 0;
+    for (auto &worker : workers)
+        worker.join();
+}
 
-        do {
-            struct req_entry entry;
-            uint64_t new_time_us = get_cur_time_us();
+/**
+ * Virtual-time equivalent of `bench_closed_loop_round()`. Every queue
+ * slot is an entry in a min-heap keyed by the time it becomes free; the
+ * earliest slot issues next, at exactly its free time, so the sequence of
+ * start times handed to the simulator is nondecreasing.
+ */
+static void
+bench_closed_loop_round_virtual(struct job_stream *jobs,
+                                unsigned int direction, bool random, int qd)
+{
+    typedef std::pair<uint64_t, int> slot_t;    // (free time, job index)
+    std::priority_queue<slot_t, std::vector<slot_t>,
+                        std::greater<slot_t> > slots;
+    uint64_t base_time_us, end_time_us, last_time_us;
 
-            entry.direction = DIR_READ;
-            entry.addr = PAGE_SIZE * addr_dist(rand_gen);;
-            entry.size = PAGE_SIZE;
-            entry.start_time_us = new_time_us;
+    base_time_us = virt_time_us;
+    end_time_us = base_time_us + 1000000 * SECS_PER_ROUND;
+    window_reset(base_time_us + 1000000, end_time_us);
 
-            if (new_time_us - base_time_us >= 1000000)
-                log_interval_us += new_time_us - cur_time_us;
-            cur_time_us = new_time_us;
+    for (int j = 0; j < num_jobs; ++j)
+        for (int slot = 0; slot < qd; ++slot)
+            slots.push(slot_t(base_time_us, j));
 
-            if (log_interval_us > 100000) {
-                throughputs.push_back(log_query_throughput(cur_time_us
-                                                           - log_interval_us,
-                                                           cur_time_us));
-                log_interval_us = 0;
-            }
+    last_time_us = end_time_us;
 
-            {
-                std::lock_guard<std::mutex> lk(submit_queue_lock);
+    while (!slots.empty()) {
+        slot_t slot = slots.top();
+        uint64_t finish_time_us;
+        unsigned long addr;
+        struct device *dev;
 
-                submit_queue.push_back(entry);
-                submit_queue_cv.notify_all();
-            }
+        slots.pop();
+        if (slot.first >= end_time_us)
+            continue;
 
-            usleep(delta_us);
-        } while (cur_time_us < base_time_us + 1000000 * SECS_PER_ROUND);
+        dev = map_addr(job_next_addr(&jobs[slot.second], random), &addr);
+        finish_time_us = slot.first
+                         + _submit(dev, direction, addr, PAGE_SIZE,
+                                   slot.first);
 
-        double avg_throughput = std::accumulate(throughputs.begin(),
-                                                throughputs.end(),
-                                                0.0) / throughputs.size();
-        printf("  %20d     %15.5lf\n", intensity, avg_throughput);
-        fflush(stdout);
+        window_push_entry(dev, slot.first, finish_time_us, PAGE_SIZE);
 
-        bench_clean_up();
+        slots.push(slot_t(finish_time_us, slot.second));
+        last_time_us = std::max(last_time_us, finish_time_us);
     }
+
+    virt_time_us = last_time_us;
 }
 
 /**
- * Benchmark - uniformly random read.
+ * Run one benchmark over all intensities (open-loop) or all queue depths
+ * 1, 2, 4, ... up to `max_qd` (closed-loop), one result line per step.
  */
 static void
-bench_rnd_write()
+bench_run(std::string title, unsigned int direction, bool random)
 {
-    std::default_random_engine rand_gen;
-    std::uniform_int_distribution<unsigned long> addr_dist(0,
-                                                           FLASH_SPACE
-                                                           / PAGE_SIZE);
-
-    std::cout << "Benchmark - Uniformly Random Write:"          << std::endl
-              << "  Intensity (#4K-Reqs/s)   Throughput (KB/s)" << std::endl;
-
-    for (int intensity = INTENSITY_TICK; intensity <= MAX_INTENSITY;
-         intensity += INTENSITY_TICK) {
-
-        /** A round of benchmarking for given intensity. */
-        uint64_t delta_us = 1000000 / intensity;
-        uint64_t base_time_us, cur_time_us, log_interval_us = 0;
-        std::vector<double> throughputs;
-
-        base_time_us = get_cur_time_us();
-        cur_time_us = base_time_us;
-        log_interval_us = 0;
+    std::vector<struct job_stream> jobs(num_jobs);
 
-        do {
-            struct req_entry entry;
-            uint64_t new_time_us = get_cur_time_us();
-
-            entry.direction = DIR_WRITE;
-            entry.addr = PAGE_SIZE * addr_dist(rand_gen);;
-            entry.size = PAGE_SIZE;
-            entry.start_time_us = new_time_us;
-
-            if (new_time_us - base_time_us >= 1000000)
-                log_interval_us += new_time_us - cur_time_us;
-            cur_time_us = new_time_us;
+    for (int j = 0; j < num_jobs; ++j) {
+        jobs[j].addr = (array_space() / PAGE_SIZE / num_jobs) * j * PAGE_SIZE;
+        jobs[j].rand_gen.seed(j + 1);
+    }
 
-            if (log_interval_us > 100000) {
-                throughputs.push_back(log_query_throughput(cur_time_us
-                                                           - log_interval_us,
-                                                           cur_time_us));
-                log_interval_us = 0;
-            }
+    std::cout << "Benchmark - " << title << ":" << std::endl;
+
+    if (mode == MODE_OPEN) {
+        std::cout << "  Intensity (#4K-Reqs/s)   Throughput (KB/s)"
+                  << "          IOPS    p50 (us)    p99 (us)  p99.9 (us)"
+                  << "    max (us)" << std::endl;
+
+        for (int intensity = INTENSITY_TICK; intensity <= MAX_INTENSITY;
+             intensity += INTENSITY_TICK) {
+            if (time_mode == TIME_VIRTUAL)
+                bench_open_loop_round_virtual(&jobs[0], direction, random,
+                                              intensity);
+            else
+                bench_open_loop_round(&jobs[0], direction, random,
+                                      intensity);
+            bench_clean_up();
+            window_report(intensity);
+        }
 
-            {
-                std::lock_guard<std::mutex> lk(submit_queue_lock);
+    } else {
+        std::cout << "  Queue Depth (per job)    Throughput (KB/s)"
+                  << "          IOPS    p50 (us)    p99 (us)  p99.9 (us)"
+                  << "    max (us)" << std::endl;
+
+        for (int qd = 1; ; qd = std::min(qd * 2, max_qd)) {
+            if (time_mode == TIME_VIRTUAL)
+                bench_closed_loop_round_virtual(jobs.data(), direction,
+                                                random, qd);
+            else
+                bench_closed_loop_round(jobs.data(), direction, random, qd);
+            bench_clean_up();
+            window_report(qd);
+
+            if (qd == max_qd)
+                break;
+        }
+    }
+}
 
-                submit_queue.push_back(entry);
-                submit_queue_cv.notify_all();
-            }
+/** Benchmark - sequential read. */
+static void
+bench_seq_read()
+{
+    bench_run("Logical Sequential Read", DIR_READ, false);
+}
 
-            usleep(delta_us);
-        } while (cur_time_us < base_time_us + 1000000 * SECS_PER_ROUND);
+/** Benchmark - sequential write. */
+static void
+bench_seq_write()
+{
+    bench_run("Logical Sequential Write", DIR_WRITE, false);
+}
 
-        double avg_throughput = std::accumulate(throughputs.begin(),
-                                                throughputs.end(),
-                                                0.0) / throughputs.size();
-        printf("  %20d     %15.5lf\n", intensity, avg_throughput);
-        fflush(stdout);
+/** Benchmark - uniformly random read. */
+static void
+bench_rnd_read()
+{
+    bench_run("Uniformly Random Read", DIR_READ, true);
+}
 
-        bench_clean_up();
-    }
+/** Benchmark - uniformly random write. */
+static void
+bench_rnd_write()
+{
+    bench_run("Uniformly Random Write", DIR_WRITE, true);
 }
 
 
 /**
- * Fill device with randomly written data.
+ * Fill all devices with sequentially written data.
  */
 static void
 bench_fill_device()
 {
-    unsigned long addr = 0;
-    
-    for (size_t i = 0; i < (FLASH_SPACE / PAGE_SIZE); ++i) {
-        addr = i * PAGE_SIZE;
-        _submit_write(addr, PAGE_SIZE, get_cur_time_us());
+    for (size_t i = 0; i < (array_space() / PAGE_SIZE); ++i) {
+        unsigned long addr;
+        struct device *dev = map_addr(i * PAGE_SIZE, &addr);
+
+        if (time_mode == TIME_VIRTUAL)
+            virt_time_us += _submit(dev, DIR_WRITE, addr, PAGE_SIZE,
+                                    virt_time_us);
+        else
+            _submit_and_wait(dev, DIR_WRITE, addr, PAGE_SIZE);
     }
 
     bench_clean_up();
 }
 
-/*========== Benchmarking Implemention BEGIN. ==========*/
+/*========== Benchmarking Implemention END. ==========*/
 
 
+static void
+usage()
+{
+    std::cout << "Usage: ./lt-bench [-m open|closed] [-t wall|virtual] "
+              << "[-j JOBS] [-q QD] [-s STRIPE] SOCK_NAME [SOCK_NAME ...]"
+              << std::endl
+              << "  -m  open-loop intensity sweep (default) or closed-loop "
+              << "queue depth sweep" << std::endl
+              << "  -t  wall-clock time with real sleeps (default) or "
+              << "simulated time only" << std::endl
+              << "  -j  number of closed-loop jobs (default 1)" << std::endl
+              << "  -q  max queue depth per closed-loop job (default 1)"
+              << std::endl
+              << "  -s  pages per stripe unit across devices (default 1)"
+              << std::endl;
+    exit(1);
+}
+
 int
 main(int argc, char *argv[])
 {
-    if (argc != 2)
-        error("please provide one argument: the socket file path");
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:t:j:q:s:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (strcmp(optarg, "open") == 0)
+                mode = MODE_OPEN;
+            else if (strcmp(optarg, "closed") == 0)
+                mode = MODE_CLOSED;
+            else
+                usage();
+            break;
+        case 't':
+            if (strcmp(optarg, "wall") == 0)
+                time_mode = TIME_WALL;
+            else if (strcmp(optarg, "virtual") == 0)
+                time_mode = TIME_VIRTUAL;
+            else
+                usage();
+            break;
+        case 'j':
+            num_jobs = atoi(optarg);
+            break;
+        case 'q':
+            max_qd = atoi(optarg);
+            break;
+        case 's':
+            stripe_pages = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage();
+        }
+    }
 
-    sock_name = argv[1];
+    if (optind >= argc || num_jobs <= 0 || max_qd <= 0 || stripe_pages == 0
+        || stripe_pages > FLASH_SPACE / PAGE_SIZE)
+        usage();
 
     if (sizeof(struct req_header) != REQ_HEADER_LENGTH)
         error("request header length incorrect");
 
     gettimeofday(&boot_time, NULL);
 
-    /** Open client socket & connect. */
-    prepare_socket();
+    /** Open client sockets & connect, one per device. */
+    for (int i = optind; i < argc; ++i) {
+        struct device *dev = new struct device;
+
+        dev->index = devices.size();
+        dev->sock_name = argv[i];
+        devices.push_back(dev);
+
+        prepare_socket(dev);
+    }
 
     bench_fill_device();
 
-    /** Create the separate submission thread. */
-    std::thread submit_thread(_submit_thread_func);
-    submit_thread.detach();
+    /** Create the separate submission threads. */
+    if (mode == MODE_OPEN && time_mode == TIME_WALL) {
+        for (struct device *dev : devices) {
+            std::thread submit_thread(_submit_thread_func, dev);
+            submit_thread.detach();
+        }
+    }
 
     bench_seq_read();
     bench_rnd_read();
@@ -0,0 +1,439 @@
+/**
+ * Micro-benchmarks for the simulator hot paths.
+ *
+ * Each case runs its body in batches, doubling the batch size until one
+ * batch takes at least the minimum run time, and reports the last batch
+ * as ns/op, allocations/op and allocated bytes/op. Allocations are
+ * counted by replacing the global operator new, so any heap traffic a
+ * change adds to a hot path shows up directly in the numbers.
+ *
+ * Cases that need a whole device build one from `ssd.conf` with the FTL
+ * overridden and page data disabled. Setup work inside a case body (e.g.
+ * the writes that keep garbage collection busy) is excluded from the
+ * reported numbers through bench_pause() / bench_resume().
+ *
+ * Usage: ./micro-bench [-t MIN_SECS] [FILTER]
+ * Only cases whose name contains FILTER are run.
+ */
+
+
+#include <string>
+#include <vector>
+#include <new>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+
+/** Heap accounting through global operator new replacement. */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static unsigned long alloc_count = 0;
+static unsigned long alloc_bytes = 0;
+
+void *
+operator new(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == NULL)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *
+operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void
+operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void
+operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void
+operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void
+operator delete[](void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+
+/** Benchmarking parameters. */
+static double min_secs = 0.5;
+static const char *filter = NULL;
+
+/** Keeps results observable so loop bodies are not optimized away. */
+static volatile unsigned long sink;
+
+
+static inline unsigned long
+now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+
+/**
+ * Time and allocations spent while paused inside the current batch,
+ * subtracted from the batch totals.
+ */
+static unsigned long paused_at_ns, paused_at_count, paused_at_bytes;
+static unsigned long paused_ns, paused_count, paused_bytes;
+
+static void
+bench_pause()
+{
+    paused_at_count = alloc_count;
+    paused_at_bytes = alloc_bytes;
+    paused_at_ns = now_ns();
+}
+
+static void
+bench_resume()
+{
+    paused_ns += now_ns() - paused_at_ns;
+    paused_count += alloc_count - paused_at_count;
+    paused_bytes += alloc_bytes - paused_at_bytes;
+}
+
+
+static bool
+bench_selected(const std::string &name)
+{
+    return filter == NULL || name.find(filter) != std::string::npos;
+}
+
+/**
+ * Run BODY repeatedly in growing batches and print the per-op cost of
+ * the first batch that lasts at least `min_secs`. BODY keeps its own
+ * state across calls, so stateful cases continue where they stopped.
+ */
+template <typename F>
+static void
+run_bench(const std::string &name, F body)
+{
+    if (!bench_selected(name))
+        return;
+
+    unsigned long iters = 1;
+    while (true) {
+        paused_ns = paused_count = paused_bytes = 0;
+        unsigned long count_begin = alloc_count;
+        unsigned long bytes_begin = alloc_bytes;
+        unsigned long begin = now_ns();
+
+        for (unsigned long i = 0; i < iters; ++i)
+            body();
+
+        unsigned long elapsed = now_ns() - begin - paused_ns;
+        unsigned long count = alloc_count - count_begin - paused_count;
+        unsigned long bytes = alloc_bytes - bytes_begin - paused_bytes;
+
+        if (elapsed >= min_secs * 1e9 || iters >= (1UL << 32)) {
+            printf("  %-40s  %12lu  %12.1lf  %10.2lf  %10.1lf\n",
+                   name.c_str(), iters, (double) elapsed / iters,
+                   (double) count / iters, (double) bytes / iters);
+            fflush(stdout);
+            return;
+        }
+        iters *= 2;
+    }
+}
+
+
+/** Build a device from the loaded config running the given FTL. */
+static Ssd *
+make_ssd(int ftl)
+{
+    char ftl_name[] = "FTL_IMPLEMENTATION";
+    load_entry(ftl_name, ftl, 0);
+    return new Ssd();
+}
+
+/** Mutable view of a device's FTL, for calling its hooks directly. */
+static FtlParent &
+ftl_of(Ssd &ssd)
+{
+    return const_cast<FtlParent &>(ssd.get_controller().get_ftl());
+}
+
+/** Number of logical pages the FTLs expose. */
+static ulong
+num_lpns()
+{
+    return (ulong) NUMBER_OF_ADDRESSABLE_BLOCKS * BLOCK_SIZE;
+}
+
+/** Simple deterministic LCG so runs are comparable. */
+static inline ulong
+next_rand(ulong &state)
+{
+    state = state * 6364136223846793005UL + 1442695040888963407UL;
+    return state >> 33;
+}
+
+
+/**
+ * Channel::lock with a steady backlog of BACKLOG unit-length transfers
+ * queued ahead of each arrival. Arrivals advance by one unit per lock, so
+ * exactly one entry expires per call and the table size stays constant.
+ */
+static void
+bench_channel_lock(uint backlog)
+{
+    Channel channel(BUS_CTRL_DELAY, BUS_DATA_DELAY, BUS_TABLE_SIZE, BUS_MAX_CONNECT);
+    Event event(READ, 0, 1, 0.0);
+
+    for (uint i = 0; i < backlog; ++i)
+        channel.lock(0.0, 1.0, event);
+
+    double time = (backlog == 0) ? 0.0 : 1.0;
+    double step = (backlog == 0) ? 2.0 : 1.0;
+
+    run_bench("Channel::lock backlog=" + std::to_string(backlog), [&]() {
+        channel.lock(time, 1.0, event);
+        time += step;
+    });
+}
+
+static void
+bench_address()
+{
+    ulong total = (ulong) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * PLANE_SIZE * BLOCK_SIZE;
+    Address address;
+    ulong linear = 0;
+
+    run_bench("Address::set_linear_address", [&]() {
+        address.set_linear_address(linear, PAGE);
+        sink += address.block;
+        linear = (linear + 7919) % total;
+    });
+}
+
+static void
+bench_event()
+{
+    ulong lpn = 0;
+
+    run_bench("Event::Event", [&]() {
+        Event event(WRITE, lpn++, 1, 0.0);
+        sink += event.get_logical_address();
+    });
+}
+
+
+/**
+ * Exposes the protected DFTL mapping lookup. Taking the member pointer
+ * through a derived class is allowed; the class is never instantiated.
+ */
+class DftlProbe : public FtlImpl_DftlParent
+{
+public:
+    static void resolve(FtlImpl_DftlParent &ftl, Event &event, bool is_write)
+    {
+        (ftl.*(&DftlProbe::resolve_mapping))(event, is_write);
+    }
+};
+
+/**
+ * resolve_mapping on cached mappings, then on mappings that always miss
+ * the CMT so every lookup evicts an entry and reads a translation page.
+ * Both include constructing the lookup event.
+ */
+static void
+bench_dftl_resolve()
+{
+    if (!bench_selected("DftlParent::resolve_mapping"))
+        return;
+
+    Ssd *ssd = make_ssd(IMPL_DFTL);
+    FtlImpl_DftlParent &ftl = static_cast<FtlImpl_DftlParent &>(ftl_of(*ssd));
+    double time = 0.0;
+
+    /* Few enough LPNs to stay resident in the CMT. */
+    const ulong hot = 1024;
+    for (ulong lpn = 0; lpn < hot; ++lpn) {
+        Event event(READ, lpn, 1, time);
+        DftlProbe::resolve(ftl, event, false);
+        time += 10.0;
+    }
+
+    ulong lpn = 0;
+    run_bench("DftlParent::resolve_mapping hit", [&]() {
+        Event event(READ, lpn, 1, time);
+        DftlProbe::resolve(ftl, event, false);
+        lpn = (lpn + 1) % hot;
+        time += 10.0;
+    });
+
+    /* Sweep the whole space with a stride so LRU never has it cached. */
+    ulong total = num_lpns();
+    lpn = hot;
+    run_bench("DftlParent::resolve_mapping miss", [&]() {
+        Event event(READ, lpn, 1, time);
+        DftlProbe::resolve(ftl, event, false);
+        lpn = (lpn + 4099) % total;
+        time += 10.0;
+    });
+
+    delete ssd;
+}
+
+/**
+ * Block_manager::insert_events once the device is past its GC threshold.
+ * Before each timed call, one block worth of random overwrites (paused)
+ * creates fresh invalid pages for victim selection to find.
+ */
+static void
+bench_insert_events()
+{
+    if (!bench_selected("Block_manager::insert_events"))
+        return;
+
+    Ssd *ssd = make_ssd(IMPL_DFTL);
+    double time = 0.0;
+    ulong span = num_lpns() * 3 / 4;
+    ulong state = 42;
+
+    for (ulong lpn = 0; lpn < span; ++lpn) {
+        ssd->event_arrive(WRITE, lpn, 1, time);
+        time += 10.0;
+    }
+
+    run_bench("Block_manager::insert_events", [&]() {
+        bench_pause();
+        for (uint i = 0; i < BLOCK_SIZE; ++i) {
+            ssd->event_arrive(WRITE, next_rand(state) % span, 1, time);
+            time += 10.0;
+        }
+        bench_resume();
+
+        Event event(WRITE, 0, 1, time);
+        Block_manager::instance()->insert_events(event);
+        time += 10.0 + event.get_time_taken();
+    });
+
+    delete ssd;
+}
+
+/**
+ * FAST reads with the log blocks filled by random overwrites. Both a page
+ * that was never overwritten and an overwritten one are found with a
+ * single log_index lookup; the former then falls back to the sequential
+ * log or the data block.
+ */
+static void
+bench_fast_read()
+{
+    if (!bench_selected("FtlImpl_Fast::read"))
+        return;
+
+    Ssd *ssd = make_ssd(IMPL_FAST);
+    FtlParent &ftl = ftl_of(*ssd);
+    double time = 0.0;
+    ulong span = 32 * BLOCK_SIZE;
+    ulong state = 7;
+
+    for (ulong lpn = 0; lpn < span; ++lpn) {
+        ssd->event_arrive(WRITE, lpn, 1, time);
+        time += 10.0;
+    }
+
+    /* Fill the log short of a merge, skipping block-aligned offsets that
+     * would start a sequential log block instead. */
+    std::vector<bool> in_log(span, false);
+    std::vector<ulong> logged;
+    ulong fill = (FAST_LOG_BLOCK_LIMIT - 1) * BLOCK_SIZE - 1;
+    while (logged.size() < fill) {
+        ulong lpn = next_rand(state) % span;
+        if (lpn % BLOCK_SIZE == 0 || in_log[lpn])
+            continue;
+        ssd->event_arrive(WRITE, lpn, 1, time);
+        time += 10.0;
+        in_log[lpn] = true;
+        logged.push_back(lpn);
+    }
+
+    std::vector<ulong> clean;
+    for (ulong lpn = 0; lpn < span; ++lpn)
+        if (!in_log[lpn])
+            clean.push_back(lpn);
+
+    size_t idx = 0;
+    run_bench("FtlImpl_Fast::read log miss", [&]() {
+        Event event(READ, clean[idx], 1, time);
+        ftl.read(event);
+        idx = (idx + 1) % clean.size();
+        time += 10.0;
+    });
+
+    idx = 0;
+    run_bench("FtlImpl_Fast::read log hit", [&]() {
+        Event event(READ, logged[idx], 1, time);
+        ftl.read(event);
+        idx = (idx + 1) % logged.size();
+        time += 10.0;
+    });
+
+    delete ssd;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        switch (opt) {
+        case 't':
+            min_secs = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-t MIN_SECS] [FILTER]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (optind < argc)
+        filter = argv[optind];
+
+    load_config();
+    char data_name[] = "PAGE_ENABLE_DATA";
+    load_entry(data_name, 0, 0);
+
+    printf("  %-40s  %12s  %12s  %10s  %10s\n",
+           "Benchmark", "Iterations", "ns/op", "allocs/op", "B/op");
+
+    uint backlogs[] = {0, 1, 4, 16, 64, 256};
+    for (uint backlog : backlogs)
+        bench_channel_lock(backlog);
+    bench_address();
+    bench_event();
+    bench_dftl_resolve();
+    bench_insert_events();
+    bench_fast_read();
+
+    return 0;
+}
@@ -0,0 +1,278 @@
+/**
+ * Simulator speed and memory benchmark.
+ *
+ * For every FTL and every capacity on a ladder, builds a device and runs
+ * a few standard synthetic workloads against it, measuring how long the
+ * device takes to construct, how many simulated requests it serves per
+ * wall-clock second, and the peak resident set size. This is the number
+ * to check before committing to a geometry: if construction alone runs
+ * out of memory or time here, the geometry is not feasible.
+ *
+ * Capacity is scaled through PLANE_SIZE on top of the base config. Each
+ * (FTL, capacity, workload) run happens in its own forked child, so peak
+ * RSS is per run and a crash or timeout is recorded rather than ending
+ * the sweep. Results are written to a CSV file, replacing it.
+ *
+ * Usage: ./simspeed [-f FTLS] [-p PLANE_SIZES] [-n REQUESTS]
+ *                   [-T TIMEOUT_SECS] [-o OUT_CSV] [CONFIG]
+ * FTLS and PLANE_SIZES are comma-separated lists, e.g. `-f 0,1,2`.
+ */
+
+
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+
+/** Benchmarking parameters. */
+static std::vector<int> ftls = {IMPL_PAGE, IMPL_BAST, IMPL_FAST, IMPL_DFTL, IMPL_BIMODAL, IMPL_TPFTL, IMPL_LEARNED, IMPL_VDFTL};
+static std::vector<int> plane_sizes = {4, 16, 64};
+static unsigned long num_requests = 200000;
+static unsigned int timeout_secs = 600;
+static const char *out_name = "simspeed.csv";
+static const char *config_name = "ssd.conf";
+
+static const char *ftl_names[] = {"page", "bast", "fast", "dftl", "bdftl", "tpftl", "learned", "vdftl"};
+
+
+/**
+ * Standard workloads, as Workload job keys. Random ones stay within a
+ * quarter of the device so log-block FTLs keep room for their logs.
+ */
+struct workload_spec {
+    const char *name;
+    std::vector<std::pair<const char *, const char *>> keys;
+};
+
+static const std::vector<workload_spec> workloads = {
+    {"seqwrite", {{"rw", "write"}, {"size", "25%"}}},
+    {"randwrite", {{"rw", "randwrite"}, {"size", "25%"}}},
+    {"zipf-mixed", {{"rw", "randrw"}, {"rwmixread", "70"}, {"size", "25%"},
+                    {"random_distribution", "zipf:0.9"}, {"iodepth", "8"}}},
+};
+
+
+/** What a child reports back to the parent through a pipe. */
+struct run_result {
+    unsigned long blocks;
+    double construct_secs;
+    unsigned long requests;
+    double run_secs;
+};
+
+
+static double
+now_secs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+parse_list(const char *str, std::vector<int> &list)
+{
+    list.clear();
+    std::string copy(str);
+    char *saveptr;
+    for (char *tok = strtok_r(&copy[0], ",", &saveptr); tok != NULL;
+         tok = strtok_r(NULL, ",", &saveptr))
+        list.push_back(atoi(tok));
+}
+
+
+/**
+ * Load the base config with overrides appended, so that derived values
+ * such as NUMBER_OF_ADDRESSABLE_BLOCKS are recomputed by load_config().
+ */
+static void
+load_overridden_config(int ftl, int plane_size)
+{
+    char path[] = "/tmp/simspeed-XXXXXX";
+    int fd = mkstemp(path);
+    FILE *base = fopen(config_name, "r");
+    FILE *conf = fdopen(fd, "w");
+    if (fd < 0 || base == NULL || conf == NULL) {
+        fprintf(stderr, "Cannot prepare config from %s\n", config_name);
+        exit(1);
+    }
+
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), base)) > 0)
+        fwrite(buf, 1, n, conf);
+    fprintf(conf, "\nFTL_IMPLEMENTATION %d\n", ftl);
+    fprintf(conf, "PLANE_SIZE %d\n", plane_size);
+    fprintf(conf, "PAGE_ENABLE_DATA 0\n");
+    fclose(base);
+    fclose(conf);
+
+    load_config(path);
+    unlink(path);
+}
+
+/** Body of a child process: one device, one workload. */
+static void
+run_child(int ftl, int plane_size, const workload_spec &spec, int fd)
+{
+    /* The simulator is chatty on stdout. */
+    if (freopen("/dev/null", "w", stdout) == NULL)
+        exit(1);
+    alarm(timeout_secs);
+
+    load_overridden_config(ftl, plane_size);
+
+    struct run_result result;
+    result.blocks = NUMBER_OF_ADDRESSABLE_BLOCKS;
+
+    double begin = now_secs();
+    Ssd *ssd = new Ssd();
+    result.construct_secs = now_secs() - begin;
+
+    Workload workload;
+    for (auto &kv : spec.keys)
+        workload.set(kv.first, kv.second);
+    workload.set("number_ios", std::to_string(num_requests).c_str());
+
+    TraceReplayer replayer(*ssd, workload);
+    workload.configure(replayer);
+
+    begin = now_secs();
+    result.requests = replayer.replay();
+    result.run_secs = now_secs() - begin;
+
+    if (write(fd, &result, sizeof(result)) != sizeof(result))
+        exit(1);
+    _exit(0);
+}
+
+/**
+ * Fork a child for one run and wait for it. Peak RSS comes from the
+ * child's rusage, so it is known even when the child dies.
+ */
+static void
+run_one(FILE *out, int ftl, int plane_size, const workload_spec &spec)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+
+    fflush(stdout);
+    fflush(out);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        run_child(ftl, plane_size, spec, fds[1]);
+    }
+    close(fds[1]);
+
+    struct run_result result;
+    memset(&result, 0, sizeof(result));
+    bool got = read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+
+    std::string state = "ok";
+    if (WIFSIGNALED(status))
+        state = (WTERMSIG(status) == SIGALRM) ? "timeout"
+                : std::string("signal ") + std::to_string(WTERMSIG(status));
+    else if (!got || WEXITSTATUS(status) != 0)
+        state = "exit " + std::to_string(WEXITSTATUS(status));
+
+    double capacity_mib = (double) SSD_SIZE * PACKAGE_SIZE * DIE_SIZE * plane_size
+                          * BLOCK_SIZE * PAGE_SIZE / (1024.0 * 1024.0);
+    double req_per_sec = (got && result.run_secs > 0) ? result.requests / result.run_secs : 0.0;
+
+    printf("  %-7s %10.0lf %12s %12.4lf %10lu %14.0lf %12ld  %s\n",
+           ftl_names[ftl], capacity_mib, spec.name, result.construct_secs,
+           result.requests, req_per_sec, usage.ru_maxrss, state.c_str());
+    fflush(stdout);
+
+    fprintf(out, "%s,%d,%lu,%.0lf,%s,%.6lf,%lu,%.6lf,%.1lf,%ld,%s\n",
+            ftl_names[ftl], plane_size, result.blocks, capacity_mib, spec.name,
+            result.construct_secs, result.requests, result.run_secs,
+            req_per_sec, usage.ru_maxrss, state.c_str());
+    fflush(out);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "f:p:n:T:o:")) != -1) {
+        switch (opt) {
+        case 'f':
+            parse_list(optarg, ftls);
+            break;
+        case 'p':
+            parse_list(optarg, plane_sizes);
+            break;
+        case 'n':
+            num_requests = strtoul(optarg, NULL, 10);
+            break;
+        case 'T':
+            timeout_secs = atoi(optarg);
+            break;
+        case 'o':
+            out_name = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-f FTLS] [-p PLANE_SIZES] [-n REQUESTS] "
+                            "[-T TIMEOUT_SECS] [-o OUT_CSV] [CONFIG]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (optind < argc)
+        config_name = argv[optind];
+
+    for (int ftl : ftls) {
+        if (ftl < IMPL_PAGE || ftl > IMPL_VDFTL) {
+            fprintf(stderr, "Unknown FTL implementation %d\n", ftl);
+            exit(1);
+        }
+    }
+
+    /* Base geometry, for reporting capacities. */
+    load_config(config_name);
+
+    FILE *out = fopen(out_name, "w");
+    if (out == NULL) {
+        perror(out_name);
+        exit(1);
+    }
+    fprintf(out, "ftl,plane_size,blocks,capacity_mib,workload,construct_secs,"
+                 "requests,run_secs,requests_per_sec,peak_rss_kb,status\n");
+
+    printf("  %-7s %10s %12s %12s %10s %14s %12s  %s\n", "FTL", "Cap(MiB)",
+           "Workload", "Build(s)", "Requests", "Req/s", "PeakRSS(KB)", "Status");
+    for (int plane_size : plane_sizes)
+        for (int ftl : ftls)
+            for (const workload_spec &spec : workloads)
+                run_one(out, ftl, plane_size, spec);
+
+    fclose(out);
+    printf("Results written to %s\n", out_name);
+    return 0;
+}
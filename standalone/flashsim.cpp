@@ -4,17 +4,27 @@
  * Made this standalone version to enable non-C++ projects to interact with
  * multiple simulated flash SSDs interactively.
  *
+ * Next to the request socket SOCK_NAME, the simulator serves live metrics
+ * on SOCK_NAME.metrics: connect, send `prometheus` or `json` (or an HTTP
+ * GET, e.g. `curl --unix-socket SOCK_NAME.metrics http://x/metrics`, with
+ * `?format=json` for JSON) and the current snapshot comes back.
+ *
  * Author: Guanzhou Hu <guanzhou.hu@wisc.edu>, 2020.
  */
 
 
 #include <string>
 #include <iostream>
+#include <atomic>
+#include <thread>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <signal.h>
 #include <unistd.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -29,6 +39,8 @@ using namespace ssd;
 static Ssd *ssd_handle;
 static std::string sock_name;
 static int ssock;
+static std::string metrics_sock_name;
+static int msock = -1;
 
 
 /**
@@ -45,6 +57,12 @@ clean_up(int signal)
     if (!sock_name.empty())
         unlink(sock_name.c_str());
 
+    if (msock >= 0)
+        close(msock);
+
+    if (!metrics_sock_name.empty())
+        unlink(metrics_sock_name.c_str());
+
     if (ssd_handle != NULL)
         delete ssd_handle;
 
@@ -137,33 +155,378 @@ process_read(ulong addr, uint size, double start_time_ms)
 
 
 /**
- * Open a server-side socket for clients to make requests.
- * We only allow one client connection at a time.
+ * Live metrics.
+ * The simulation thread owns the Ssd and its statistics; it copies what
+ * the dashboards need into a plain snapshot and publishes it under a
+ * sequence lock. The metrics thread copies the snapshot out and retries
+ * if a publish overlapped, so it never blocks the simulation.
  */
+static const unsigned METRICS_MAX_CHANNELS = 64;
+static const double METRICS_PUBLISH_INTERVAL = 0.1;     // seconds
+static const int NUM_OPS = 3;
+
+static const char *op_names[NUM_OPS] = {"read", "write", "trim"};
+static const char *cause_names[NUM_EVENT_CAUSES] = {"host", "gc", "merge",
+                                                    "mapping", "wl"};
+static const double quantiles[] = {0.5, 0.99, 0.999};
+static const char *quantile_names[] = {"p50", "p99", "p999"};
+static const int NUM_QUANTILES = sizeof(quantiles) / sizeof(quantiles[0]);
+
+struct metrics_snapshot {
+    double simulated_secs;
+    unsigned long requests[NUM_OPS];
+    double latency_sum_secs[NUM_OPS];
+    double latency_quantile_secs[NUM_OPS][NUM_QUANTILES];
+    double latency_max_secs[NUM_OPS];
+    long host_pages_written;
+    long flash_programs[NUM_EVENT_CAUSES];
+    long flash_erases[NUM_EVENT_CAUSES];
+    double write_amplification;
+    long free_blocks;
+    long log_blocks;
+    long cached_mappings;
+    long cmt_hits;
+    long cmt_misses;
+    unsigned num_channels;
+    double channel_utilization[METRICS_MAX_CHANNELS];
+    double die_utilization_mean;
+    double plane_utilization_mean;
+};
+
+static std::atomic<unsigned> metrics_seq(0);
+static struct metrics_snapshot metrics;     // guarded by metrics_seq
+static double simulated_ms;
+static bool metrics_dirty;
+static double metrics_published_at;
+
+static double
+now_secs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** Take a snapshot of the device. Simulation thread only. */
 static void
-prepare_socket()
+publish_metrics()
+{
+    struct metrics_snapshot snap;
+    const Stats &stats = ssd_handle->get_controller().stats;
+    const Histogram *latencies[NUM_OPS] = {&stats.readLatency,
+                                           &stats.writeLatency,
+                                           &stats.trimLatency};
+
+    memset(&snap, 0, sizeof(snap));
+    snap.simulated_secs = simulated_ms / 1000.0;
+    for (int i = 0; i < NUM_OPS; i++) {
+        snap.requests[i] = latencies[i]->get_count();
+        snap.latency_sum_secs[i] = latencies[i]->get_sum() / 1000.0;
+        for (int q = 0; q < NUM_QUANTILES; q++)
+            snap.latency_quantile_secs[i][q] =
+                latencies[i]->percentile(quantiles[q] * 100.0) / 1000.0;
+        snap.latency_max_secs[i] = latencies[i]->get_max() / 1000.0;
+    }
+
+    snap.host_pages_written = stats.numHostWrite;
+    for (int i = 0; i < NUM_EVENT_CAUSES; i++) {
+        snap.flash_programs[i] = stats.numFlashProgram[i];
+        snap.flash_erases[i] = stats.numFlashErase[i];
+    }
+    snap.write_amplification = stats.write_amplification();
+
+    snap.free_blocks = Block_manager::instance()->get_num_free_blocks();
+    snap.log_blocks = Block_manager::instance()->get_num_log_blocks();
+    snap.cached_mappings =
+        ssd_handle->get_controller().get_ftl().get_num_cached_mappings();
+    snap.cmt_hits = stats.numCacheHits;
+    snap.cmt_misses = stats.numCacheFaults;
+
+    double span = ssd_handle->utilization_span();
+    double min, max, queue;
+    snap.num_channels = SSD_SIZE < METRICS_MAX_CHANNELS ? SSD_SIZE
+                                                       : METRICS_MAX_CHANNELS;
+    for (unsigned i = 0; i < snap.num_channels; i++)
+        snap.channel_utilization[i] = ssd_handle->get_utilization(
+            Address(i, 0, 0, 0, 0, PACKAGE)).get_utilization(span);
+    ssd_handle->utilization_summary(DIE, span, snap.die_utilization_mean,
+                                    min, max, queue);
+    ssd_handle->utilization_summary(PLANE, span, snap.plane_utilization_mean,
+                                    min, max, queue);
+
+    unsigned seq = metrics_seq.load(std::memory_order_relaxed);
+    metrics_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&metrics, &snap, sizeof(snap));
+    metrics_seq.store(seq + 2, std::memory_order_release);
+
+    metrics_dirty = false;
+    metrics_published_at = now_secs();
+}
+
+/** Copy out a consistent snapshot. Metrics thread only. */
+static void
+read_metrics(struct metrics_snapshot &snap)
+{
+    unsigned before, after;
+
+    do {
+        before = metrics_seq.load(std::memory_order_acquire);
+        memcpy(&snap, &metrics, sizeof(snap));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = metrics_seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+static void
+append(std::string &out, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void
+append(std::string &out, const char *fmt, ...)
+{
+    char line[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    out += line;
+}
+
+static void
+prometheus_header(std::string &out, const char *name, const char *type,
+                  const char *help)
+{
+    append(out, "# HELP flashsim_%s %s\n# TYPE flashsim_%s %s\n",
+           name, help, name, type);
+}
+
+/** Prometheus text exposition format, version 0.0.4. */
+static std::string
+format_prometheus(const struct metrics_snapshot &m)
+{
+    std::string out;
+
+    prometheus_header(out, "simulated_time_seconds", "gauge",
+                      "Latest finish time of a host request.");
+    append(out, "flashsim_simulated_time_seconds %.9g\n", m.simulated_secs);
+
+    prometheus_header(out, "request_latency_seconds", "summary",
+                      "Host request response time, simulated.");
+    for (int i = 0; i < NUM_OPS; i++) {
+        for (int q = 0; q < NUM_QUANTILES; q++)
+            append(out, "flashsim_request_latency_seconds{op=\"%s\",quantile=\"%g\"} %.9g\n",
+                   op_names[i], quantiles[q], m.latency_quantile_secs[i][q]);
+        append(out, "flashsim_request_latency_seconds_sum{op=\"%s\"} %.9g\n",
+               op_names[i], m.latency_sum_secs[i]);
+        append(out, "flashsim_request_latency_seconds_count{op=\"%s\"} %lu\n",
+               op_names[i], m.requests[i]);
+    }
+
+    prometheus_header(out, "request_latency_max_seconds", "gauge",
+                      "Slowest host request so far.");
+    for (int i = 0; i < NUM_OPS; i++)
+        append(out, "flashsim_request_latency_max_seconds{op=\"%s\"} %.9g\n",
+               op_names[i], m.latency_max_secs[i]);
+
+    prometheus_header(out, "host_pages_written_total", "counter",
+                      "Pages written by the host.");
+    append(out, "flashsim_host_pages_written_total %ld\n", m.host_pages_written);
+
+    prometheus_header(out, "flash_programs_total", "counter",
+                      "Flash pages programmed, by cause.");
+    for (int i = 0; i < NUM_EVENT_CAUSES; i++)
+        append(out, "flashsim_flash_programs_total{cause=\"%s\"} %ld\n",
+               cause_names[i], m.flash_programs[i]);
+
+    prometheus_header(out, "flash_erases_total", "counter",
+                      "Flash blocks erased, by cause.");
+    for (int i = 0; i < NUM_EVENT_CAUSES; i++)
+        append(out, "flashsim_flash_erases_total{cause=\"%s\"} %ld\n",
+               cause_names[i], m.flash_erases[i]);
+
+    prometheus_header(out, "write_amplification", "gauge",
+                      "Flash pages programmed per host page written.");
+    append(out, "flashsim_write_amplification %.9g\n", m.write_amplification);
+
+    prometheus_header(out, "free_blocks", "gauge", "Blocks in the free pool.");
+    append(out, "flashsim_free_blocks %ld\n", m.free_blocks);
+    prometheus_header(out, "log_blocks", "gauge", "Blocks in use as log blocks.");
+    append(out, "flashsim_log_blocks %ld\n", m.log_blocks);
+    prometheus_header(out, "cached_mappings", "gauge",
+                      "Entries in the cached mapping table.");
+    append(out, "flashsim_cached_mappings %ld\n", m.cached_mappings);
+
+    prometheus_header(out, "cmt_lookups_total", "counter",
+                      "Cached mapping table lookups, by result.");
+    append(out, "flashsim_cmt_lookups_total{result=\"hit\"} %ld\n", m.cmt_hits);
+    append(out, "flashsim_cmt_lookups_total{result=\"miss\"} %ld\n", m.cmt_misses);
+
+    prometheus_header(out, "channel_utilization", "gauge",
+                      "Fraction of simulated time each channel was busy.");
+    for (unsigned i = 0; i < m.num_channels; i++)
+        append(out, "flashsim_channel_utilization{channel=\"%u\"} %.9g\n",
+               i, m.channel_utilization[i]);
+    prometheus_header(out, "die_utilization_mean", "gauge",
+                      "Mean fraction of simulated time dies were busy.");
+    append(out, "flashsim_die_utilization_mean %.9g\n", m.die_utilization_mean);
+    prometheus_header(out, "plane_utilization_mean", "gauge",
+                      "Mean fraction of simulated time planes were busy.");
+    append(out, "flashsim_plane_utilization_mean %.9g\n", m.plane_utilization_mean);
+
+    return out;
+}
+
+static std::string
+format_json(const struct metrics_snapshot &m)
+{
+    std::string out;
+    long hits_and_misses = m.cmt_hits + m.cmt_misses;
+
+    append(out, "{\"simulated_time_seconds\":%.9g,\"requests\":{",
+           m.simulated_secs);
+    for (int i = 0; i < NUM_OPS; i++) {
+        append(out, "%s\"%s\":{\"count\":%lu,\"latency_sum_seconds\":%.9g",
+               i > 0 ? "," : "", op_names[i], m.requests[i],
+               m.latency_sum_secs[i]);
+        for (int q = 0; q < NUM_QUANTILES; q++)
+            append(out, ",\"latency_%s_seconds\":%.9g", quantile_names[q],
+                   m.latency_quantile_secs[i][q]);
+        append(out, ",\"latency_max_seconds\":%.9g}", m.latency_max_secs[i]);
+    }
+
+    append(out, "},\"host_pages_written\":%ld,\"flash_programs\":{",
+           m.host_pages_written);
+    for (int i = 0; i < NUM_EVENT_CAUSES; i++)
+        append(out, "%s\"%s\":%ld", i > 0 ? "," : "", cause_names[i],
+               m.flash_programs[i]);
+    append(out, "},\"flash_erases\":{");
+    for (int i = 0; i < NUM_EVENT_CAUSES; i++)
+        append(out, "%s\"%s\":%ld", i > 0 ? "," : "", cause_names[i],
+               m.flash_erases[i]);
+
+    append(out, "},\"write_amplification\":%.9g,\"free_blocks\":%ld,"
+                "\"log_blocks\":%ld,\"cached_mappings\":%ld,",
+           m.write_amplification, m.free_blocks, m.log_blocks,
+           m.cached_mappings);
+    append(out, "\"cmt_hits\":%ld,\"cmt_misses\":%ld,\"cmt_hit_ratio\":%.9g,",
+           m.cmt_hits, m.cmt_misses,
+           hits_and_misses > 0 ? (double) m.cmt_hits / hits_and_misses : 0.0);
+
+    append(out, "\"channel_utilization\":[");
+    for (unsigned i = 0; i < m.num_channels; i++)
+        append(out, "%s%.9g", i > 0 ? "," : "", m.channel_utilization[i]);
+    append(out, "],\"die_utilization_mean\":%.9g,"
+                "\"plane_utilization_mean\":%.9g}\n",
+           m.die_utilization_mean, m.plane_utilization_mean);
+
+    return out;
+}
+
+/**
+ * Serve one metrics client: read its request, answer with the current
+ * snapshot in the requested format, plain or wrapped in an HTTP response.
+ */
+static void
+serve_metrics(int csock)
+{
+    char req[1024];
+    struct timeval timeout = {1, 0};
+    struct metrics_snapshot snap;
+
+    setsockopt(csock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int rbytes = read(csock, req, sizeof(req) - 1);
+    req[rbytes > 0 ? rbytes : 0] = '\0';
+
+    /** Only the first line matters: `json`, or `GET /metrics?format=json`. */
+    req[strcspn(req, "\r\n")] = '\0';
+    bool http = strncmp(req, "GET ", 4) == 0;
+    bool json = strstr(req, "json") != NULL;
+
+    read_metrics(snap);
+    std::string body = json ? format_json(snap) : format_prometheus(snap);
+    std::string resp;
+
+    if (http)
+        append(resp, "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+                     "Content-Length: %zu\r\n\r\n",
+               json ? "application/json"
+                    : "text/plain; version=0.0.4; charset=utf-8",
+               body.size());
+    resp += body;
+
+    size_t sent = 0;
+    while (sent < resp.size()) {
+        ssize_t wbytes = write(csock, resp.data() + sent, resp.size() - sent);
+        if (wbytes <= 0)
+            break;
+        sent += wbytes;
+    }
+}
+
+static void
+metrics_loop()
+{
+    while (1) {
+        int csock = accept(msock, NULL, NULL);
+        if (csock < 0)
+            continue;
+        serve_metrics(csock);
+        close(csock);
+    }
+}
+
+
+/**
+ * Open a server-side socket on the given sock file.
+ */
+static int
+listen_on(const std::string &name, int backlog)
 {
     struct sockaddr_un saddr;
-    int ret;
+    int sock, ret;
 
-    ssock = socket(AF_LOCAL, SOCK_STREAM, 0);
-    if (ssock < 0)
+    sock = socket(AF_LOCAL, SOCK_STREAM, 0);
+    if (sock < 0)
         error("socket() failed");
 
     memset(&saddr, 0, sizeof(saddr));
     saddr.sun_family = AF_LOCAL;
-    strncpy(saddr.sun_path, sock_name.c_str(), sizeof(saddr.sun_path) - 1);
+    strncpy(saddr.sun_path, name.c_str(), sizeof(saddr.sun_path) - 1);
 
-    ret = bind(ssock, (struct sockaddr *) &saddr, sizeof(saddr));
+    ret = bind(sock, (struct sockaddr *) &saddr, sizeof(saddr));
     if (ret)
         error("bind() failed");
 
-    ret = listen(ssock, 1);
+    ret = listen(sock, backlog);
     if (ret)
         error("listen() failed");
 
-    std::cout << "Listening on local socket file `" << sock_name << "`..."
+    std::cout << "Listening on local socket file `" << name << "`..."
               << std::endl;
+    return sock;
+}
+
+/**
+ * Open a server-side socket for clients to make requests.
+ * We only allow one client connection at a time.
+ */
+static void
+prepare_socket()
+{
+    ssock = listen_on(sock_name, 1);
+}
+
+/**
+ * Open the metrics socket and start serving it from its own thread.
+ */
+static void
+prepare_metrics()
+{
+    publish_metrics();
+    msock = listen_on(metrics_sock_name, 16);
+    std::thread(metrics_loop).detach();
 }
 
 
@@ -178,6 +541,17 @@ request_loop(int csock)
         char buf[REQ_HEADER_LENGTH];
         int rbytes, wbytes;
 
+        /**
+         * Publish metrics at most every METRICS_PUBLISH_INTERVAL while
+         * busy, and as soon as the client goes quiet for that long.
+         */
+        if (metrics_dirty) {
+            struct pollfd pfd = {csock, POLLIN, 0};
+            if (now_secs() - metrics_published_at >= METRICS_PUBLISH_INTERVAL
+                || poll(&pfd, 1, METRICS_PUBLISH_INTERVAL * 1000) == 0)
+                publish_metrics();
+        }
+
         /** Read request header message. */
         bzero(buf, sizeof(buf));
         rbytes = read(csock, buf, REQ_HEADER_LENGTH);
@@ -260,6 +634,10 @@ request_loop(int csock)
             if (time_used_ms <= 0)
                 error("negative processing time");
 
+            if (start_time_ms + time_used_ms > simulated_ms)
+                simulated_ms = start_time_ms + time_used_ms;
+            metrics_dirty = true;
+
             time_used_us = (unsigned long) (time_used_ms * 1000);
 
             wbytes = write(csock, &time_used_us, 8);
@@ -267,6 +645,9 @@ request_loop(int csock)
                 error("send back processing time failed");
         }
     }
+
+    if (metrics_dirty)
+        publish_metrics();
 }
 
 
@@ -279,6 +660,7 @@ main(int argc, char *argv[])
         usage();
 
     sock_name = argv[1];
+    metrics_sock_name = sock_name + ".metrics";
 
     if (argc == 2)
         load_config();
@@ -299,6 +681,7 @@ main(int argc, char *argv[])
 
     /** Open server socket, bind, & listen. */
     prepare_socket();
+    prepare_metrics();
     std::cout << "SSD simulator BOOTED" << std::endl;
 
     /** Register Ctrl+C handler. */
@@ -0,0 +1,68 @@
+/**
+ * Block trace to FlashSim binary trace converter.
+ *
+ * Parses a text trace once and writes it out in the fixed-record binary
+ * format (see `BinaryTraceHeader` in ssd.h), which replays without any
+ * per-record parsing.
+ *
+ * Usage: ./traceconv FORMAT IN_TRACE OUT_TRACE [TIME_UNIT_NS]
+ */
+
+
+#include <string>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ssd.h"
+
+using namespace ssd;
+
+
+static void
+usage()
+{
+    std::cout << "Usage: ./traceconv msr|spc|blkparse|fio IN_TRACE "
+              << "OUT_TRACE [TIME_UNIT_NS]" << std::endl
+              << "  TIME_UNIT_NS defaults to 100 for msr (its native "
+              << "resolution) and 1000 otherwise" << std::endl;
+    exit(1);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    enum trace_format format;
+    uint32_t time_unit;
+    TraceRecord record;
+
+    if (argc != 4 && argc != 5)
+        usage();
+
+    if (!trace_format_from_name(argv[1], format) || format == TRACE_BINARY)
+        usage();
+
+    time_unit = (format == TRACE_MSR) ? 100 : 1000;
+    if (argc == 5)
+        time_unit = strtoul(argv[4], NULL, 10);
+    if (time_unit == 0)
+        usage();
+
+    TraceFile trace(argv[2], format);
+    BinaryTraceWriter writer(argv[3], format, time_unit);
+    unsigned long requests = 0;
+
+    while (trace.next(record)) {
+        writer.append(record);
+        requests++;
+    }
+
+    writer.close();
+
+    std::cout << "Converted " << requests << " requests into "
+              << writer.get_num_records() << " records of `" << argv[3]
+              << "`" << std::endl;
+
+    return 0;
+}
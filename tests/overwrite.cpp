@@ -0,0 +1,95 @@
+/* overwrite.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Full-device overwrite driver
+ *
+ * Fills the whole logical capacity of the page FTL sequentially on the SSD
+ * described by ssd.conf, overwrites it twice more in order and once at
+ * random, then reads every page back.  A write past the exported capacity
+ * must fail cleanly.
+ * 	./overwrite
+ * The configuration is written to overwrite.conf in the working
+ * directory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+static void write_config(const char *path)
+{
+	FILE *in = fopen("ssd.conf", "r");
+	FILE *out = fopen(path, "w");
+	char line[256];
+
+	if (in == NULL || out == NULL)
+	{
+		fprintf(stderr, "Could not copy ssd.conf to %s\n", path);
+		exit(FILE_ERR);
+	}
+
+	while (fgets(line, sizeof(line), in) != NULL)
+		fputs(line, out);
+
+	/* later entries override the ones of ssd.conf */
+	fprintf(out, "\nFTL_IMPLEMENTATION 0\n");
+
+	fclose(in);
+	fclose(out);
+}
+
+int main()
+{
+	write_config("overwrite.conf");
+	load_config("overwrite.conf");
+	print_config(NULL);
+	printf("\n");
+
+	Ssd *ssd = new Ssd();
+	const Controller &controller = ssd -> get_controller();
+	ulong pages = controller.get_ftl().get_logical_pages();
+	double time = 0.0;
+	int errors = 0;
+
+	for (uint pass = 0; pass < 3; pass++)
+		for (ulong i = 0; i < pages; i++)
+			time += ssd -> event_arrive(WRITE, i, 1, time);
+
+	srandom(1);
+	for (ulong i = 0; i < pages; i++)
+		time += ssd -> event_arrive(WRITE, random() % pages, 1, time);
+
+	for (ulong i = 0; i < pages; i++)
+		time += ssd -> event_arrive(READ, i, 1, time);
+
+	printf("Wrote %lu logical pages four times: %ld FTL writes, %ld FTL reads, %ld GC writes.\n",
+		pages, controller.stats.numFTLWrite, controller.stats.numFTLRead, controller.stats.numGCWrite);
+	if ((ulong) controller.stats.numFTLWrite != 4 * pages || (ulong) controller.stats.numFTLRead != pages)
+		errors++;
+
+	/* the FTL must turn the write down, not map it */
+	ssd -> event_arrive(WRITE, pages, 1, time);
+	if ((ulong) controller.stats.numFTLWrite != 4 * pages)
+	{
+		printf("Write past the %lu logical pages succeeded.\n", pages);
+		errors++;
+	}
+
+	delete ssd;
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/* replay.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Trace replay driver
+ *
+ * Replays a block trace against the SSD described by ssd.conf.
+ * 	./replay FORMAT TRACE [QUEUE_DEPTH [TIME_SCALE [LBA_MODULO [TRACE_JSON]]]]
+ * FORMAT is one of msr, spc, blkparse, fio or binary.  A queue depth of 0 (the
+ * default) replays open loop, honouring the trace timestamps.  LBA_MODULO
+ * (in pages) folds the trace into a smaller logical space; log-block FTLs
+ * need it to leave room for their log blocks.  Given TRACE_JSON, every
+ * hardware operation is written there as a Chrome trace. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+int main(int argc, char **argv)
+{
+	enum trace_format format;
+
+	if (argc < 3 || argc > 7 || !trace_format_from_name(argv[1], format))
+	{
+		printf("Usage: %s msr|spc|blkparse|fio|binary TRACE [QUEUE_DEPTH [TIME_SCALE [LBA_MODULO [TRACE_JSON]]]]\n", argv[0]);
+		exit(-1);
+	}
+
+	load_config();
+	print_config(NULL);
+	printf("\n");
+
+	Ssd *ssd = new Ssd();
+	TraceSource *trace = open_trace(argv[2], format);
+	TraceReplayer replayer(*ssd, *trace);
+
+	if (argc > 3)
+		replayer.set_queue_depth(atoi(argv[3]));
+	if (argc > 4)
+		replayer.set_time_scale(atof(argv[4]));
+	if (argc > 5)
+		replayer.set_lba_modulo(strtoul(argv[5], NULL, 10));
+
+	Tracer *tracer = NULL;
+	if (argc > 6)
+		tracer = new Tracer(*ssd, argv[6]);
+
+	ulong requests = replayer.replay();
+	printf("Replayed %lu requests.\n", requests);
+
+	if (tracer != NULL)
+	{
+		printf("Traced %lu operations to %s.\n", tracer -> get_num_records(), argv[6]);
+		delete tracer;
+	}
+
+	replayer.print_statistics();
+	ssd -> print_statistics();
+
+	delete trace;
+	delete ssd;
+	return 0;
+}
@@ -0,0 +1,111 @@
+/* tracer.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Tracer driver
+ *
+ * Traces page FTL writes, striped over every die, and reads on the SSD
+ * described by ssd.conf regrouped into packages of 4 dies of 1 plane each,
+ * so that dies per package and planes per die differ.  Then checks that
+ * every die got a track of its own, named after it.
+ * 	./tracer [TRACE_JSON]
+ * TRACE_JSON defaults to tracer.json.  The regrouped configuration is
+ * written to tracer.conf in the working directory. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include "ssd.h"
+
+using namespace ssd;
+
+static void write_config(const char *path)
+{
+	FILE *in = fopen("ssd.conf", "r");
+	FILE *out = fopen(path, "w");
+	char line[256];
+
+	if (in == NULL || out == NULL)
+	{
+		fprintf(stderr, "Could not copy ssd.conf to %s\n", path);
+		exit(FILE_ERR);
+	}
+
+	while (fgets(line, sizeof(line), in) != NULL)
+		fputs(line, out);
+
+	/* later entries override the ones of ssd.conf */
+	fprintf(out, "\nPACKAGE_SIZE 4\nDIE_SIZE 1\nFTL_IMPLEMENTATION 0\n");
+
+	fclose(in);
+	fclose(out);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : "tracer.json";
+
+	write_config("tracer.conf");
+	load_config("tracer.conf");
+	print_config(NULL);
+	printf("\n");
+
+	Ssd *ssd = new Ssd();
+	Tracer *tracer = new Tracer(*ssd, path);
+
+	ulong pages = 4000;
+	double time = 0.0;
+	for (ulong i = 0; i < pages; i++)
+		time += ssd -> event_arrive(WRITE, i * 7 % pages, 1, time);
+	for (ulong i = 0; i < pages; i += 16)
+		time += ssd -> event_arrive(READ, i, 1, time);
+
+	printf("Traced %lu operations to %s.\n", tracer -> get_num_records(), path);
+	delete tracer;
+	delete ssd;
+
+	FILE *trace = fopen(path, "r");
+	char line[512];
+	std::set<uint> dies;
+	int errors = 0;
+
+	if (trace == NULL)
+	{
+		fprintf(stderr, "Could not read %s\n", path);
+		exit(FILE_ERR);
+	}
+
+	while (fgets(line, sizeof(line), trace) != NULL)
+	{
+		const char *name = strstr(line, "\"name\":\"die ");
+		uint package, die;
+
+		if (name == NULL || sscanf(name, "\"name\":\"die %u.%u", &package, &die) != 2)
+			continue;
+
+		if (package >= SSD_SIZE || die >= PACKAGE_SIZE)
+		{
+			printf("Track for nonexistent die %u.%u\n", package, die);
+			errors++;
+		}
+		dies.insert(package * PACKAGE_SIZE + die);
+	}
+	fclose(trace);
+
+	printf("%lu of %u dies traced, %d bad tracks.\n", dies.size(), SSD_SIZE * PACKAGE_SIZE, errors);
+	return errors == 0 && dies.size() == SSD_SIZE * PACKAGE_SIZE ? 0 : 1;
+}
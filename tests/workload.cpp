@@ -0,0 +1,67 @@
+/* workload.cpp is part of FlashSim. */
+
+/* FlashSim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version. */
+
+/* FlashSim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License
+ * along with FlashSim.  If not, see <http://www.gnu.org/licenses/>. */
+
+/****************************************************************************/
+
+/* Synthetic workload driver
+ *
+ * Runs a fio-like job file against the SSD described by ssd.conf.
+ * 	./workload [JOB_FILE [SAMPLE_FILE [SAMPLE_INTERVAL]]]
+ * JOB_FILE defaults to workload.job.  Given a SAMPLE_FILE, device state is
+ * sampled into it every SAMPLE_INTERVAL (default 1000) simulated time
+ * units. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ssd.h"
+
+using namespace ssd;
+
+int main(int argc, char **argv)
+{
+	load_config();
+	print_config(NULL);
+	printf("\n");
+
+	Workload workload(argc > 1 ? argv[1] : "workload.job");
+	workload.print();
+
+	Ssd *ssd = new Ssd();
+	TraceReplayer replayer(*ssd, workload);
+	workload.configure(replayer);
+
+	Sampler *sampler = NULL;
+	if (argc > 2)
+	{
+		sampler = new Sampler(*ssd, argv[2]);
+		sampler -> set_interval_time(argc > 3 ? atof(argv[3]) : 1000.0);
+	}
+
+	ulong requests = replayer.replay();
+	printf("Issued %lu requests.\n", requests);
+
+	if (sampler != NULL)
+	{
+		sampler -> flush();
+		printf("Wrote %lu samples to %s.\n", sampler -> get_num_samples(), argv[2]);
+		delete sampler;
+	}
+
+	replayer.print_statistics();
+	ssd -> print_statistics();
+
+	delete ssd;
+	return 0;
+}